@@ -0,0 +1,178 @@
+// Checks of the AsyncSimulator completion paths: cancelling queued and
+// running launches, deadlines expiring while every worker is busy, then(),
+// submissions during shutdown and, when the compiler supports coroutines,
+// co_await. Reports every failed check and exits non-zero if there was one.
+
+#include "projectile-core.h"
+#include "projectile-test.h"
+
+#include <chrono>
+#include <future>
+
+typedef AsyncSimulator::Clock Clock;
+
+static double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Holds the worker running a launch inside begin() until released
+class BlockingSink : public TrajectorySink {
+private:
+    std::promise<void> startedPromise;
+    std::promise<void> releasePromise;
+    std::shared_future<void> releaseFuture;
+
+public:
+    std::shared_future<void> started;
+
+    BlockingSink() : releaseFuture(releasePromise.get_future().share()),
+                     started(startedPromise.get_future().share()) {}
+
+    void begin(const ProjectileData&) override {
+        startedPromise.set_value();
+        releaseFuture.wait();
+    }
+    void push(const TrajectoryState&) override {}
+    void end() override {}
+
+    void release() { releasePromise.set_value(); }
+};
+
+// Slows every state down so the launch runs for many slices
+class SlowSink : public TrajectorySink {
+private:
+    std::promise<void> startedPromise;
+
+public:
+    std::shared_future<void> started;
+
+    SlowSink() : started(startedPromise.get_future().share()) {}
+
+    void begin(const ProjectileData&) override { startedPromise.set_value(); }
+    void push(const TrajectoryState&) override { std::this_thread::sleep_for(std::chrono::microseconds(200)); }
+    void end() override {}
+};
+
+static ProjectileData longLaunch() {
+    ProjectileData data;
+    data.initialVelocity = 300;
+    data.angle = 60;
+    data.airResistance = true;
+    data.dragCoefficient = 0.1f;
+    return data;
+}
+
+static void testQueuedCancelAndDeadline() {
+    AsyncSimulator simulator(1);
+    BlockingSink blocker;
+    LaunchFuture busy = simulator.submit(longLaunch(), Clock::time_point::max(), &blocker);
+    blocker.started.wait();
+
+    LaunchFuture queued = simulator.submit(longLaunch());
+    bool delivered = false;
+    queued.then([&](const AsyncLaunchResult& result) { delivered = result.status == LaunchStatus::Cancelled; });
+    queued.cancel();
+    check(queued.ready(), "a cancelled queued launch completes at once");
+    check(queued.get().status == LaunchStatus::Cancelled, "a cancelled queued launch is Cancelled");
+    check(delivered, "then() sees the cancellation of a queued launch");
+
+    Clock::time_point start = Clock::now();
+    LaunchFuture expiring = simulator.submit(longLaunch(), std::chrono::milliseconds(50));
+    check(expiring.waitFor(std::chrono::seconds(5)), "a queued deadline expires while the worker is busy");
+    check(expiring.get().status == LaunchStatus::TimedOut, "an expired queued launch is TimedOut");
+    check(millisecondsSince(start) < 2000, "a queued deadline expires on time");
+    check(!busy.ready(), "the busy launch is still running");
+
+    blocker.release();
+    check(busy.get().status == LaunchStatus::Finished, "the blocking launch finishes once released");
+}
+
+static void testRunningCancel() {
+    AsyncSimulator simulator(1);
+    SlowSink slow;
+    LaunchFuture running = simulator.submit(longLaunch(), Clock::time_point::max(), &slow);
+    slow.started.wait();
+    running.cancel();
+    check(running.get().status == LaunchStatus::Cancelled, "a cancelled running launch is Cancelled");
+}
+
+static void testShutdown() {
+    SlowSink slow;
+    LaunchFuture running, queued, late;
+    Clock::time_point start;
+    {
+        AsyncSimulator simulator(1);
+        running = simulator.submit(longLaunch(), Clock::time_point::max(), &slow);
+        queued = simulator.submit(longLaunch());
+        // Runs on the destructor's thread once the queue is dropped
+        queued.then([&](const AsyncLaunchResult&) { late = simulator.submit(longLaunch()); });
+        slow.started.wait();
+        start = Clock::now();
+    }
+    check(millisecondsSince(start) < 2000, "shutdown does not wait for running launches to land");
+    check(running.get().status == LaunchStatus::Cancelled, "shutdown cancels running launches");
+    check(queued.get().status == LaunchStatus::Cancelled, "shutdown cancels queued launches");
+    check(late.valid() && late.ready() && late.get().status == LaunchStatus::Cancelled,
+          "a launch submitted during shutdown completes as Cancelled");
+}
+
+#if PROJECTILE_COROUTINES
+// Coroutine that starts eagerly and reports the awaited result
+struct AwaitTask {
+    struct promise_type {
+        AwaitTask get_return_object() { return AwaitTask(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+static AwaitTask awaitLaunch(LaunchFuture future, std::promise<AsyncLaunchResult>& out) {
+    AsyncLaunchResult result = co_await future;
+    out.set_value(result);
+}
+
+static void testCoroutines() {
+    AsyncSimulator simulator(1);
+    ProjectileData data;
+    data.airResistance = true;
+
+    std::promise<AsyncLaunchResult> finished;
+    awaitLaunch(simulator.submit(data), finished);
+    AsyncLaunchResult result = finished.get_future().get();
+    check(result.status == LaunchStatus::Finished, "co_await resumes with a finished launch");
+    check(result.stats.range == ProjectileSimulator(data).calculateMetrics().range,
+          "co_await returns the launch statistics");
+
+    BlockingSink blocker;
+    LaunchFuture busy = simulator.submit(longLaunch(), Clock::time_point::max(), &blocker);
+    blocker.started.wait();
+    LaunchFuture queued = simulator.submit(longLaunch());
+    std::promise<AsyncLaunchResult> cancelled;
+    std::future<AsyncLaunchResult> cancelledResult = cancelled.get_future();
+    awaitLaunch(queued, cancelled);
+    queued.cancel();
+    check(cancelledResult.wait_for(std::chrono::seconds(5)) == std::future_status::ready &&
+          cancelledResult.get().status == LaunchStatus::Cancelled,
+          "co_await resumes when a queued launch is cancelled");
+    blocker.release();
+    busy.get();
+}
+#endif
+
+int main() {
+    testQueuedCancelAndDeadline();
+    testRunningCancel();
+    testShutdown();
+#if PROJECTILE_COROUTINES
+    testCoroutines();
+#elif defined(PROJECTILE_REQUIRE_COROUTINES)
+    std::cerr << "FAILED: coroutines are not available in this build\n";
+    failures++;
+#else
+    std::cout << "co_await checks skipped (no coroutine support)\n";
+#endif
+
+    return report("async");
+}
@@ -0,0 +1,386 @@
+// Microbenchmarks for the simulator kernels: single launches, metrics-only
+// runs, batched sweeps, the raw drag step kernels at several step sizes and
+// the text visualization path. Each case is repeated until it has run for
+// at least --min-time seconds and reports launches/sec and ns/step.
+//
+//   projectile-benchmark [--filter <substring>] [--min-time <seconds>]
+
+#include "projectile-core.h"
+#include "projectile-kernels.h"
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+
+// Work done by one call of a benchmark body
+struct BenchmarkWork {
+    uint64_t launches;
+    uint64_t steps; // integrator steps, 0 when not meaningful
+
+    BenchmarkWork(uint64_t launches = 0, uint64_t steps = 0) : launches(launches), steps(steps) {}
+};
+
+// Discards everything written to it; used to time the text output path
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+// Keeps results observable so the optimizer cannot drop the work
+volatile float benchmarkSink = 0;
+
+class BenchmarkRunner {
+private:
+    std::string filter;
+    double minTime;
+
+public:
+    BenchmarkRunner(const std::string& filter, double minTime) : filter(filter), minTime(minTime) {
+        std::cout << std::left << std::setw(44) << "Benchmark" << std::right
+                  << std::setw(12) << "Iterations"
+                  << std::setw(16) << "Launches/s"
+                  << std::setw(14) << "ns/launch"
+                  << std::setw(12) << "ns/step" << "\n";
+        std::cout << std::string(98, '-') << "\n";
+    }
+
+    template <typename Body>
+    void run(const std::string& name, Body&& body) {
+        if (!filter.empty() && name.find(filter) == std::string::npos) return;
+
+        typedef std::chrono::steady_clock Clock;
+        uint64_t iterations = 0, launches = 0, steps = 0;
+        double elapsed = 0;
+
+        Clock::time_point start = Clock::now();
+        do {
+            BenchmarkWork work = body();
+            launches += work.launches;
+            steps += work.steps;
+            iterations++;
+            elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        } while (elapsed < minTime);
+
+        double ns = elapsed * 1e9;
+        std::cout << std::left << std::setw(44) << name << std::right
+                  << std::setw(12) << iterations
+                  << std::fixed << std::setprecision(0)
+                  << std::setw(16) << launches / elapsed
+                  << std::setprecision(1)
+                  << std::setw(14) << ns / launches;
+        if (steps > 0) {
+            std::cout << std::setw(12) << std::setprecision(2) << ns / steps;
+        } else {
+            std::cout << std::setw(12) << "-";
+        }
+        std::cout << "\n";
+    }
+};
+
+ProjectileData benchmarkLaunch(bool airResistance, Integrator integrator = Integrator::Euler) {
+    ProjectileData data;
+    data.initialVelocity = 80.0f;
+    data.angle = 40.0f;
+    data.airResistance = airResistance;
+    data.integrator = integrator;
+    return data;
+}
+
+// (velocity, angle) grid of the given size, with or without drag
+ProjectileBatch benchmarkSweep(int velocities, int angles, bool airResistance) {
+    SweepGrid grid;
+    grid.velocity = SweepAxis(10.0f, 200.0f, velocities);
+    grid.angle = SweepAxis(5.0f, 85.0f, angles);
+    grid.airResistance = airResistance;
+    return grid.build();
+}
+
+// Euler steps a batch takes, from its reported flight times
+uint64_t eulerSteps(const ProjectileBatch& batch, const BatchResults& results) {
+    uint64_t steps = 0;
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (batch.airResistance[i]) steps += (uint64_t)(results.flightTime[i] / NUMERICAL_DT) + 1;
+    }
+    return steps;
+}
+
+void benchmarkSingleLaunches(BenchmarkRunner& runner) {
+    const char* names[] = {"analytical", "euler", "dormand-prince"};
+    AsyncSimulator async(1);
+    ProjectileData launches[] = {
+        benchmarkLaunch(false),
+        benchmarkLaunch(true),
+        benchmarkLaunch(true, Integrator::DormandPrince)
+    };
+
+    for (int i = 0; i < 3; i++) {
+        const ProjectileData& data = launches[i];
+        SummarySink probe;
+        ProjectileSimulator(data).simulate(probe);
+        size_t points = probe.states;
+
+        runner.run(std::string("single/trajectory/") + names[i], [&] {
+            ProjectileSimulator sim(data);
+            sim.calculateTrajectory();
+            benchmarkSink = benchmarkSink + sim.getRange();
+            return BenchmarkWork(1, points);
+        });
+
+        runner.run(std::string("single/metrics/") + names[i], [&] {
+            ProjectileSimulator sim(data);
+            benchmarkSink = benchmarkSink + sim.calculateMetrics().range;
+            return BenchmarkWork(1, data.airResistance ? points : 0);
+        });
+
+        runner.run(std::string("single/stream-summary/") + names[i], [&] {
+            ProjectileSimulator sim(data);
+            SummarySink summary;
+            sim.simulate(summary);
+            benchmarkSink = benchmarkSink + summary.metrics.range;
+            return BenchmarkWork(1, points);
+        });
+
+        runner.run(std::string("single/stream-simplify/") + names[i], [&] {
+            ProjectileSimulator sim(data);
+            SummarySink summary;
+            SimplifyingSink simplifier(summary, 0.01f);
+            sim.simulate(simplifier);
+            benchmarkSink = benchmarkSink + summary.metrics.range;
+            return BenchmarkWork(1, points);
+        });
+
+        if (data.airResistance) {
+            // A drag change late in the flight, alternating between two
+            // values so every call has work to redo
+            ProjectileSimulator sim(data);
+            sim.calculateTrajectory();
+            float changeTime = 0.8f * sim.getFlightTime();
+            int call = 0;
+            runner.run(std::string("single/resimulate-tail/") + names[i], [&] {
+                float cd = (call++ & 1) ? 0.5f : 0.45f;
+                sim.resimulateFrom(ParameterChange{changeTime, cd, data.mass});
+                benchmarkSink = benchmarkSink + sim.getRange();
+                return BenchmarkWork(1);
+            });
+        }
+
+        runner.run(std::string("single/stream-summary-fp64/") + names[i], [&] {
+            SummarySink summary;
+            summary.begin(data);
+            simulateLaunchWith<DoublePrecision>(data, STREAMING_MAX_STEPS,
+                                                [&](const TrajectoryState& state) { summary.push(state); });
+            summary.end();
+            benchmarkSink = benchmarkSink + summary.metrics.range;
+            return BenchmarkWork(1, points);
+        });
+
+        runner.run(std::string("single/stream-summary-kahan/") + names[i], [&] {
+            SummarySink summary;
+            summary.begin(data);
+            simulateLaunchWith<CompensatedPrecision>(data, STREAMING_MAX_STEPS,
+                                                     [&](const TrajectoryState& state) { summary.push(state); });
+            summary.end();
+            benchmarkSink = benchmarkSink + summary.metrics.range;
+            return BenchmarkWork(1, points);
+        });
+
+        // Submission, the sliced run on the compute thread and the wake-up
+        runner.run(std::string("single/async-round-trip/") + names[i], [&] {
+            benchmarkSink = benchmarkSink + async.submit(data).get().stats.range;
+            return BenchmarkWork(1, points);
+        });
+    }
+}
+
+void benchmarkBatches(BenchmarkRunner& runner) {
+    // 0: drag off, 1: drag on, 2: drag on with fastDrag
+    for (int drag = 0; drag <= 2; drag++) {
+        ProjectileBatch batch = benchmarkSweep(100, 100, drag != 0);
+        if (drag == 2) std::fill(batch.fastDrag.begin(), batch.fastDrag.end(), 1);
+        BatchResults results;
+        BatchSimulator sim;
+        sim.run(batch, results);
+        uint64_t steps = eulerSteps(batch, results);
+        std::string suffix = drag == 0 ? "drag-off" : drag == 1 ? "drag-on" : "drag-on-fast";
+
+        runner.run("batch/10000/" + suffix + "/" + activeDragKernel().name, [&] {
+            sim.run(batch, results);
+            benchmarkSink = benchmarkSink + results.range[batch.size() / 2];
+            return BenchmarkWork(batch.size(), steps);
+        });
+
+        SweepRunner sweep;
+        runner.run("sweep/10000/" + suffix + "/threads=" + std::to_string(sweep.threadCount()), [&] {
+            sweep.run(batch, results);
+            benchmarkSink = benchmarkSink + results.range[batch.size() / 2];
+            return BenchmarkWork(batch.size(), steps);
+        });
+
+        runner.run("loop/10000/" + suffix + "/per-launch-simulator", [&] {
+            for (size_t i = 0; i < batch.size(); i++) {
+                ProjectileSimulator single(batch.get(i));
+                single.calculateTrajectory();
+                benchmarkSink = benchmarkSink + single.getRange();
+            }
+            return BenchmarkWork(batch.size(), steps);
+        });
+    }
+}
+
+// 3D runs of the drag sweep in still sea-level air, and through the
+// standard atmosphere with a gridded wind
+void benchmarkEnvironments(BenchmarkRunner& runner) {
+    ProjectileBatch batch = benchmarkSweep(100, 100, true);
+    BatchResults flat;
+    BatchSimulator().run(batch, flat);
+    uint64_t steps = eulerSteps(batch, flat);
+
+    GriddedWind wind(41, 11, 9, Vector3D(0, 0, -400), Vector3D(100, 100, 100));
+    for (int k = 0; k < 9; k++) {
+        for (int j = 0; j < 11; j++) {
+            for (int i = 0; i < 41; i++) wind.set(i, j, k, Vector3D(-0.5f * j, 0, 0.2f * (i + k)));
+        }
+    }
+
+    for (int full = 0; full <= 1; full++) {
+        Environment environment;
+        if (full) {
+            environment.atmosphere = &TabulatedAtmosphere::standard();
+            environment.wind = &wind;
+        }
+        EnvironmentSimulator sim;
+        EnvironmentResults results;
+        runner.run(std::string("environment/10000/") + (full ? "isa-gridded-wind" : "still-air"), [&] {
+            sim.run(batch, environment, results);
+            benchmarkSink = benchmarkSink + results.range[batch.size() / 2];
+            return BenchmarkWork(batch.size(), steps);
+        });
+    }
+}
+
+void benchmarkEnsembles(BenchmarkRunner& runner) {
+    EnsembleSpec spec;
+    spec.nominal = benchmarkLaunch(true);
+    spec.velocity = ParameterDistribution(ParameterDistribution::Normal, spec.nominal.initialVelocity, 2.0f);
+    spec.angle = ParameterDistribution(ParameterDistribution::Normal, spec.nominal.angle, 1.0f);
+    spec.dragCoefficient = ParameterDistribution(ParameterDistribution::Uniform, 0.4f, 0.55f);
+    spec.count = 100000;
+
+    CpuEnsembleBackend backend;
+    EnsembleSummary summary = backend.run(spec);
+    uint64_t steps = (uint64_t)(summary.flightTime.statistics.mean / NUMERICAL_DT * spec.count);
+
+    runner.run("ensemble/100000/" + std::string(backend.name()), [&] {
+        benchmarkSink = benchmarkSink + (float)backend.run(spec).range.statistics.mean;
+        return BenchmarkWork(spec.count, steps);
+    });
+}
+
+// Runs one tile of drag lanes to completion through a specific kernel
+void benchmarkKernels(BenchmarkRunner& runner) {
+    std::vector<DragKernelInfo> kernels;
+    kernels.push_back({dragStepScalar<false>, dragStepScalar<true>, "scalar"});
+#if defined(PROJECTILE_SIMD_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back({dragStepAvx2<false>, dragStepAvx2<true>, "avx2"});
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+        kernels.push_back({dragStepAvx512<false>, dragStepAvx512<true>, "avx512"});
+    }
+#endif
+#if defined(PROJECTILE_SIMD_NEON)
+    kernels.push_back({dragStepNeon<false>, dragStepNeon<true>, "neon"});
+#endif
+
+    const size_t LANES = 256;
+    std::vector<float> x(LANES), y(LANES), vx(LANES), vy(LANES);
+    std::vector<float> gravity(LANES, 9.8f), dragFactor(LANES), mass(LANES, 1.0f), dragPerMass(LANES);
+    std::vector<float> maxY(LANES), range(LANES), flightTime(LANES);
+    std::vector<uint32_t> steps(LANES), active(LANES);
+    DragLanes lanes = {x.data(), y.data(), vx.data(), vy.data(),
+                       gravity.data(), dragFactor.data(), mass.data(), dragPerMass.data(),
+                       maxY.data(), range.data(), flightTime.data(),
+                       steps.data(), active.data(), LANES};
+
+    auto reset = [&] {
+        for (size_t i = 0; i < LANES; i++) {
+            float angleRad = (10.0f + 70.0f * i / LANES) * PI / 180.0f;
+            x[i] = y[i] = 0;
+            vx[i] = 100.0f * cos(angleRad);
+            vy[i] = 100.0f * sin(angleRad);
+            dragFactor[i] = dragFactorFor(0.47f);
+            dragPerMass[i] = dragFactor[i] / mass[i];
+            maxY[i] = range[i] = flightTime[i] = 0;
+            steps[i] = 0;
+            active[i] = ~0u;
+        }
+    };
+
+    const float stepSizes[] = {0.001f, 0.01f, 0.05f};
+    for (const DragKernelInfo& kernel : kernels) {
+        for (int fast = 0; fast < 2; fast++) {
+            for (float dt : stepSizes) {
+                DragStepKernel step = fast ? kernel.fastStep : kernel.step;
+                std::ostringstream name;
+                name << "kernel/" << kernel.name << (fast ? "-fast" : "") << "/dt=" << dt;
+                runner.run(name.str(), [&] {
+                    reset();
+                    while (step(lanes, dt) > 0) {}
+                    uint64_t total = 0;
+                    for (size_t i = 0; i < LANES; i++) total += steps[i];
+                    benchmarkSink = benchmarkSink + range[LANES / 2];
+                    return BenchmarkWork(LANES, total);
+                });
+            }
+        }
+    }
+}
+
+void benchmarkVisualization(BenchmarkRunner& runner) {
+    NullBuffer null;
+    std::ostream discard(&null);
+    for (int drag = 0; drag <= 1; drag++) {
+        ProjectileSimulator sim(benchmarkLaunch(drag != 0));
+        sim.calculateTrajectory();
+
+        runner.run(std::string("output/visualize/") + (drag ? "euler" : "analytical"), [&] {
+            sim.visualizeTrajectory(discard);
+            return BenchmarkWork(1);
+        });
+
+        runner.run(std::string("output/table/") + (drag ? "euler" : "analytical"), [&] {
+            sim.printResults(discard);
+            sim.showTrajectoryData(discard);
+            return BenchmarkWork(1);
+        });
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string filter;
+    double minTime = 0.5;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            minTime = std::atof(argv[++i]);
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--filter <substring>] [--min-time <seconds>]\n";
+            return 1;
+        }
+    }
+
+    BenchmarkRunner runner(filter, minTime);
+    benchmarkSingleLaunches(runner);
+    benchmarkBatches(runner);
+    benchmarkEnvironments(runner);
+    benchmarkEnsembles(runner);
+    benchmarkKernels(runner);
+    benchmarkVisualization(runner);
+    return 0;
+}
@@ -0,0 +1,1410 @@
+// Out-of-line parts of the projectile library (see projectile-core.h)
+#include "projectile-core.h"
+#include "projectile-kernels.h"
+#ifdef PROJECTILE_CUDA
+#include "projectile-cuda.h"
+#endif
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef PROJECTILE_PROFILE
+// Profiling builds only: the report goes to stderr when its path is "-"
+#include <iostream>
+
+void Profiler::dump() {
+    std::ofstream file;
+    if (path != "-") file.open(path);
+    std::ostream& out = path == "-" ? std::cerr : file;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<const ProfileEntry*> entries;
+    for (ProfileEntry* e = head; e; e = e->next) entries.push_back(e);
+    std::sort(entries.begin(), entries.end(), [](const ProfileEntry* a, const ProfileEntry* b) {
+        return std::strcmp(a->name, b->name) < 0;
+    });
+
+    for (int timers = 1; timers >= 0; timers--) {
+        out << (timers ? "{\n  \"timers\": {" : ",\n  \"counters\": {");
+        bool first = true;
+        for (const ProfileEntry* e : entries) {
+            if (e->timer != (timers == 1)) continue;
+            out << (first ? "\n" : ",\n") << "    \"" << e->name << "\": {\"calls\": " << e->calls.load()
+                << (timers ? ", \"ns\": " : ", \"total\": ") << e->total.load() << "}";
+            first = false;
+        }
+        out << (first ? "}" : "\n  }");
+    }
+    out << "\n}\n";
+}
+#endif
+
+DragKernelInfo selectDragKernel() {
+    const char* forced = std::getenv("PROJECTILE_SIMD");
+    std::string request = forced ? forced : "";
+    bool any = request.empty();
+
+#if defined(PROJECTILE_SIMD_X86)
+    __builtin_cpu_init();
+    if ((any || request == "avx512") && __builtin_cpu_supports("avx512f")) {
+        return {dragStepAvx512<false>, dragStepAvx512<true>, "avx512"};
+    }
+    if ((any || request == "avx2") && __builtin_cpu_supports("avx2")) {
+        return {dragStepAvx2<false>, dragStepAvx2<true>, "avx2"};
+    }
+#endif
+#if defined(PROJECTILE_SIMD_NEON)
+    if (any || request == "neon") {
+        return {dragStepNeon<false>, dragStepNeon<true>, "neon"};
+    }
+#endif
+    return {dragStepScalar<false>, dragStepScalar<true>, "scalar"};
+}
+
+const DragKernelInfo& activeDragKernel() {
+    static const DragKernelInfo kernel = selectDragKernel();
+    return kernel;
+}
+
+TrajectoryMetrics dormandPrinceMetrics(const ProjectileData& data) {
+    TrajectoryMetrics metrics;
+    bool first = true;
+    TrajectoryState prev = {0, 0, 0, 0, 0};
+
+    metrics.flightTime = simulateLaunch(data, MAX_NUMERICAL_STEPS, [&](const TrajectoryState& s) {
+        if (s.y > metrics.maxHeight) metrics.maxHeight = s.y;
+        metrics.range = s.x;
+
+        if (!first && prev.vy > 0 && s.vy <= 0) {
+            float u = prev.vy / (prev.vy - s.vy);
+            float apex = hermite(prev.y, prev.vy, s.y, s.vy, s.t - prev.t, u);
+            if (apex > metrics.maxHeight) metrics.maxHeight = apex;
+        }
+
+        first = false;
+        prev = s;
+    });
+    return metrics;
+}
+
+TrajectoryMetrics emittedMetrics(const ProjectileData& data) {
+    TrajectoryMetrics metrics;
+    metrics.flightTime = simulateLaunch(data, MAX_NUMERICAL_STEPS, [&](const TrajectoryState& s) {
+        if (s.y > metrics.maxHeight) metrics.maxHeight = s.y;
+        metrics.range = s.x;
+    });
+    return metrics;
+}
+
+size_t estimatedPointCount(const ProjectileData& data) {
+    const size_t ADAPTIVE_ESTIMATE = 64;
+    if (data.airResistance && data.integrator == Integrator::DormandPrince) return ADAPTIVE_ESTIMATE;
+
+    float angleRad = data.angle * PI / 180.0f;
+    float vy = data.initialVelocity * sin(angleRad);
+    if (vy <= 0 || data.gravity <= 0) return 2;
+
+    float dt = data.airResistance ? NUMERICAL_DT : 0.02f;
+    float steps = 2.0f * vy / data.gravity / dt;
+    if (data.airResistance && steps > MAX_NUMERICAL_STEPS) return MAX_NUMERICAL_STEPS + 2;
+    return (size_t)steps + 3;
+}
+
+std::string horizontalRule(size_t n) {
+    std::string rule;
+    rule.reserve(3 * n);
+    for (size_t i = 0; i < n; i++) rule += "─";
+    return rule;
+}
+
+// Distance from p to the segment from a to b
+static float segmentDistance(const Vector2D& p, const Vector2D& a, const Vector2D& b) {
+    float dx = b.x - a.x, dy = b.y - a.y;
+    float lengthSquared = dx * dx + dy * dy;
+    float t = lengthSquared > 0 ? ((p.x - a.x) * dx + (p.y - a.y) * dy) / lengthSquared : 0;
+    t = std::min(std::max(t, 0.0f), 1.0f);
+    return std::hypot(p.x - (a.x + t * dx), p.y - (a.y + t * dy));
+}
+
+// Splits ranges on an explicit stack rather than recursing, since a
+// trajectory can have MAX_NUMERICAL_STEPS points
+std::vector<size_t> simplifyPath(const std::vector<Vector2D>& points, float tolerance) {
+    std::vector<size_t> kept;
+    if (points.size() <= 2) {
+        for (size_t i = 0; i < points.size(); i++) kept.push_back(i);
+        return kept;
+    }
+
+    std::vector<bool> keep(points.size(), false);
+    keep.front() = keep.back() = true;
+    std::vector<std::pair<size_t, size_t>> ranges = {{0, points.size() - 1}};
+    while (!ranges.empty()) {
+        size_t first = ranges.back().first, last = ranges.back().second;
+        ranges.pop_back();
+
+        size_t farthest = first;
+        float worst = tolerance;
+        for (size_t i = first + 1; i < last; i++) {
+            float distance = segmentDistance(points[i], points[first], points[last]);
+            if (distance > worst) worst = distance, farthest = i;
+        }
+        if (farthest == first) continue;
+        keep[farthest] = true;
+        ranges.push_back({first, farthest});
+        ranges.push_back({farthest, last});
+    }
+
+    for (size_t i = 0; i < points.size(); i++) {
+        if (keep[i]) kept.push_back(i);
+    }
+    return kept;
+}
+
+TrajectoryFileWriter::TrajectoryFileWriter()
+    : out(new std::ofstream()), encoding(TrajectoryEncoding::Raw), fingerprint(0), offset(0), current() {}
+
+TrajectoryFileWriter::~TrajectoryFileWriter() {}
+
+void TrajectoryFileWriter::writeBytes(const void* data, size_t size) {
+    out->write((const char*)data, size);
+    offset += size;
+}
+
+void TrajectoryFileWriter::pad() {
+    static const char zeros[8] = {0};
+    if (offset % 8) writeBytes(zeros, 8 - offset % 8);
+}
+
+void TrajectoryFileWriter::appendVarint(std::vector<unsigned char>& bytes, uint32_t value) {
+    while (value >= 0x80) {
+        bytes.push_back((unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back((unsigned char)value);
+}
+
+void TrajectoryFileWriter::encodeColumn(int c) {
+    const std::vector<float>& values = columns[c];
+    encoded.clear();
+
+    float lo = 0, hi = 0;
+    if (!values.empty()) {
+        lo = *std::min_element(values.begin(), values.end());
+        hi = *std::max_element(values.begin(), values.end());
+    }
+    float scale = hi > lo ? (hi - lo) / 65535.0f : 1.0f;
+    current.columnMin[c] = lo;
+    current.columnScale[c] = scale;
+
+    if (encoding == TrajectoryEncoding::Raw) {
+        const unsigned char* bytes = (const unsigned char*)values.data();
+        encoded.assign(bytes, bytes + values.size() * sizeof(float));
+        return;
+    }
+
+    int32_t previous = 0, previousDelta = 0;
+    for (float value : values) {
+        int32_t q = (int32_t)std::lround((value - lo) / scale);
+        q = std::min(65535, std::max(0, q));
+        if (encoding == TrajectoryEncoding::Quantized16) {
+            uint16_t stored = (uint16_t)q;
+            encoded.push_back((unsigned char)(stored & 0xff));
+            encoded.push_back((unsigned char)(stored >> 8));
+        } else {
+            int32_t delta = q - previous;
+            int32_t change = delta - previousDelta;
+            appendVarint(encoded, ((uint32_t)change << 1) ^ (uint32_t)(change >> 31));
+            previous = q;
+            previousDelta = delta;
+        }
+    }
+}
+
+bool TrajectoryFileWriter::open(const std::string& path, TrajectoryEncoding encoding, uint64_t fingerprint) {
+    this->encoding = encoding;
+    this->fingerprint = fingerprint;
+    records.clear();
+    offset = 0;
+    out->open(path, std::ios::binary | std::ios::trunc);
+    TrajectoryFileHeader header = {};
+    writeBytes(&header, sizeof(header));
+    return (bool)*out;
+}
+
+void TrajectoryFileWriter::end() {
+    current.pointCount = (uint32_t)columns[0].size();
+    for (int c = 0; c < TRAJECTORY_COLUMNS; c++) {
+        encodeColumn(c);
+        pad();
+        current.columnOffset[c] = offset;
+        current.columnBytes[c] = encoded.size();
+        writeBytes(encoded.data(), encoded.size());
+    }
+    records.push_back(current);
+}
+
+bool TrajectoryFileWriter::close() {
+    PROFILE_SCOPE("output.binary_close");
+    pad();
+    TrajectoryFileHeader header;
+    std::memcpy(header.magic, TRAJECTORY_FILE_MAGIC, 4);
+    header.version = TRAJECTORY_FILE_VERSION;
+    header.encoding = (uint32_t)encoding;
+    header.columnCount = TRAJECTORY_COLUMNS;
+    header.launchCount = records.size();
+    header.directoryOffset = offset;
+    header.fingerprint = fingerprint;
+
+    writeBytes(records.data(), records.size() * sizeof(TrajectoryFileRecord));
+    out->seekp(0);
+    out->write((const char*)&header, sizeof(header));
+    out->close();
+    return !out->fail();
+}
+
+bool TrajectoryFileReader::validate(std::string& error) const {
+    if (length < TRAJECTORY_FILE_V1_HEADER_SIZE ||
+        std::memcmp(header().magic, TRAJECTORY_FILE_MAGIC, 4) != 0 ||
+        (header().version >= 2 && length < sizeof(TrajectoryFileHeader))) {
+        error = "not a trajectory file";
+        return false;
+    }
+    if (header().version < 1 || header().version > TRAJECTORY_FILE_VERSION ||
+        header().columnCount != TRAJECTORY_COLUMNS ||
+        header().encoding > (uint32_t)TrajectoryEncoding::DeltaQuantized) {
+        error = "unsupported trajectory file version or encoding";
+        return false;
+    }
+
+    uint64_t directoryOffset = header().directoryOffset;
+    uint64_t count = header().launchCount;
+    if (directoryOffset % 8 || directoryOffset > length ||
+        count > (length - directoryOffset) / sizeof(TrajectoryFileRecord)) {
+        error = "truncated trajectory directory";
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const TrajectoryFileRecord& r = record(i);
+        for (int c = 0; c < TRAJECTORY_COLUMNS; c++) {
+            if (r.columnOffset[c] > length || r.columnBytes[c] > length - r.columnOffset[c]) {
+                error = "column data out of range for launch " + std::to_string(i);
+                return false;
+            }
+            if (encoding() == TrajectoryEncoding::Raw &&
+                (r.columnOffset[c] % 4 || r.columnBytes[c] != (uint64_t)r.pointCount * 4)) {
+                error = "bad raw column for launch " + std::to_string(i);
+                return false;
+            }
+            if (encoding() == TrajectoryEncoding::Quantized16 &&
+                r.columnBytes[c] != (uint64_t)r.pointCount * 2) {
+                error = "bad quantized column for launch " + std::to_string(i);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool TrajectoryFileReader::open(const std::string& path, std::string& error) {
+    close();
+#if !defined(_WIN32)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open '" + path + "'";
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        error = "cannot read '" + path + "'";
+        return false;
+    }
+    void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        error = "cannot map '" + path + "'";
+        return false;
+    }
+    mapping = view;
+    base = (const unsigned char*)view;
+    length = (size_t)info.st_size;
+#else
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        error = "cannot open '" + path + "'";
+        return false;
+    }
+    contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    base = contents.data();
+    length = contents.size();
+#endif
+    if (!validate(error)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void TrajectoryFileReader::close() {
+#if !defined(_WIN32)
+    if (mapping) munmap(mapping, length);
+    mapping = nullptr;
+#endif
+    contents.clear();
+    base = nullptr;
+    length = 0;
+}
+
+void TrajectoryFileReader::decodeColumn(size_t launch, TrajectoryColumn column, std::vector<float>& out) const {
+    const TrajectoryFileRecord& r = record(launch);
+    int c = (int)column;
+    const unsigned char* bytes = base + r.columnOffset[c];
+    const unsigned char* end = bytes + r.columnBytes[c];
+    out.clear();
+    out.reserve(r.pointCount);
+
+    if (encoding() == TrajectoryEncoding::Raw) {
+        const float* values = (const float*)bytes;
+        out.assign(values, values + r.pointCount);
+    } else if (encoding() == TrajectoryEncoding::Quantized16) {
+        for (uint32_t i = 0; i < r.pointCount; i++) {
+            uint16_t q = (uint16_t)(bytes[2 * i] | bytes[2 * i + 1] << 8);
+            out.push_back(r.columnMin[c] + q * r.columnScale[c]);
+        }
+    } else {
+        int32_t q = 0, delta = 0;
+        while (bytes < end && out.size() < r.pointCount) {
+            uint32_t zigzag = 0;
+            for (int shift = 0; bytes < end && shift < 35; shift += 7) {
+                unsigned char byte = *bytes++;
+                zigzag |= (uint32_t)(byte & 0x7f) << shift;
+                if (!(byte & 0x80)) break;
+            }
+            delta += (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+            q += delta;
+            out.push_back(r.columnMin[c] + q * r.columnScale[c]);
+        }
+    }
+}
+
+TrajectoryMetrics ProjectileSimulator::calculateMetrics() const {
+    PROFILE_SCOPE("metrics.calculate");
+    if (!data.airResistance) {
+        return analyticalMetrics(data.initialVelocity, data.angle, data.gravity);
+    }
+    if (data.integrator == Integrator::DormandPrince) {
+        return dormandPrinceMetrics(data);
+    }
+    if (data.precision != FloatPrecision::Single) {
+        return emittedMetrics(data);
+    }
+
+    float angleRad = data.angle * PI / 180.0f;
+    float x = 0, y = 0;
+    float vx = data.initialVelocity * cos(angleRad);
+    float vy = data.initialVelocity * sin(angleRad);
+    float dragFactor = dragFactorFor(data.dragCoefficient);
+    float dragPerMass = dragFactor / data.mass;
+    TrajectoryMetrics metrics;
+    uint32_t steps = 0, active = ~0u;
+
+    DragLanes lane = {&x, &y, &vx, &vy, &data.gravity, &dragFactor, &data.mass, &dragPerMass,
+                      &metrics.maxHeight, &metrics.range, &metrics.flightTime,
+                      &steps, &active, 1};
+    DragStepKernel step = data.fastDrag ? dragStepScalar<true> : dragStepScalar<false>;
+    while (step(lane, NUMERICAL_DT) > 0) {}
+    return metrics;
+}
+
+void ProjectileSimulator::printResults(std::ostream& stream) const {
+    stream << "\n╔════════════════════════════════════════╗\n";
+    stream << "║   PROJECTILE MOTION SIMULATOR          ║\n";
+    stream << "╚════════════════════════════════════════╝\n\n";
+
+    stream << "📊 INPUT PARAMETERS:\n";
+    stream << "├─ Initial Velocity: " << data.initialVelocity << " m/s\n";
+    stream << "├─ Launch Angle: " << data.angle << "°\n";
+    stream << "├─ Gravity: " << data.gravity << " m/s²\n";
+    stream << "└─ Air Resistance: " << (data.airResistance ? "ON" : "OFF");
+    if (data.airResistance && data.integrator == Integrator::DormandPrince) {
+        stream << " (adaptive RK45)";
+    }
+    stream << "\n\n";
+
+    stream << "📈 RESULTS:\n";
+    stream << "├─ Maximum Height: " << std::fixed << std::setprecision(2)
+           << getMaxHeight() << " m\n";
+    stream << "├─ Range: " << getRange() << " m\n";
+    stream << "├─ Flight Time: " << getFlightTime() << " s\n";
+    stream << "├─ Apex Time: " << getApexTime() << " s\n";
+    stream << "└─ Impact Velocity: " << getImpactSpeed() << " m/s at "
+           << getImpactAngle() << "° below horizontal\n\n";
+}
+
+void ProjectileSimulator::visualizeTrajectory(std::ostream& stream, int width, int height) const {
+    PROFILE_SCOPE("visualize.ascii");
+    TrajectoryCanvas canvas(width, height);
+    canvas.include(getRange(), getMaxHeight());
+    drawOn(canvas, U'*');
+    canvas.addLegend(U'S', "Start");
+    canvas.addLegend(U'L', "Landing");
+    canvas.addLegend(U'*', "Trajectory");
+
+    // Sized for the whole frame so it goes out in one write
+    TextWriter out(stream, canvas.frameBytes(2) + 256);
+    out.text("🎯 TRAJECTORY VISUALIZATION:\n\n");
+    canvas.render(out);
+    out.text("\n  Scale: ").fixed(canvas.extentX(), 1).text(" m horizontal, ")
+       .fixed(canvas.extentY(), 1).text(" m vertical\n\n");
+}
+
+void ProjectileSimulator::showTrajectoryData(std::ostream& stream) const {
+    PROFILE_SCOPE("output.trajectory_table");
+    stream << "📋 TRAJECTORY DATA (sample points):\n";
+    stream << horizontalRule(50) << "\n";
+    stream << std::setw(10) << "Time(s)" << std::setw(15) << "X(m)"
+           << std::setw(15) << "Y(m)" << "\n";
+    stream << horizontalRule(50) << "\n";
+
+    size_t step = trajectoryPoints.size() / 10;
+    if (step == 0) step = 1;
+
+    TextWriter rows(stream);
+    for (size_t i = 0; i < trajectoryPoints.size(); i += step) {
+        rows.fixed(trajectoryTimes[i], 2, 10)
+            .fixed(trajectoryPoints[i].x, 2, 15)
+            .fixed(trajectoryPoints[i].y, 2, 15).put('\n');
+    }
+    rows.flush();
+    stream << horizontalRule(50) << "\n\n";
+}
+
+void BatchSimulator::prepare(size_t n) {
+    size_t padded = (n + DRAG_LANE_PADDING - 1) / DRAG_LANE_PADDING * DRAG_LANE_PADDING;
+    x.assign(padded, 0); y.assign(padded, 0); vx.assign(padded, 0); vy.assign(padded, 0);
+    gravity.assign(padded, 0); dragFactor.assign(padded, 0); mass.assign(padded, 1.0f);
+    dragPerMass.assign(padded, 0);
+    maxY.assign(padded, 0); range.assign(padded, 0); flightTime.assign(padded, 0);
+    steps.assign(padded, 0);
+    active.assign(padded, 0);
+}
+
+void BatchSimulator::gather(const ProjectileBatch& batch) {
+    size_t n = lanes.size();
+    prepare(n);
+
+    for (size_t i = 0; i < n; i++) {
+        size_t k = lanes[i];
+        float angleRad = batch.angle[k] * PI / 180.0f;
+        vx[i] = batch.initialVelocity[k] * cos(angleRad);
+        vy[i] = batch.initialVelocity[k] * sin(angleRad);
+        x[i] = 0;
+        y[i] = 0;
+        gravity[i] = batch.gravity[k];
+        dragFactor[i] = dragFactorFor(batch.dragCoefficient[k]);
+        mass[i] = batch.mass[k];
+        dragPerMass[i] = dragFactor[i] / mass[i];
+        maxY[i] = 0;
+        active[i] = ~0u;
+    }
+}
+
+void BatchSimulator::scatter(BatchResults& results) const {
+    for (size_t i = 0; i < lanes.size(); i++) {
+        size_t k = lanes[i];
+        results.maxHeight[k] = maxY[i];
+        results.range[k] = range[i];
+        results.flightTime[k] = flightTime[i];
+    }
+    PROFILE_COUNT("batch.steps", std::accumulate(steps.begin(), steps.end(), (uint64_t)0));
+}
+
+void BatchSimulator::stepNumerical(bool fast) {
+    DragLanes l = {x.data(), y.data(), vx.data(), vy.data(),
+                   gravity.data(), dragFactor.data(), mass.data(), dragPerMass.data(),
+                   maxY.data(), range.data(), flightTime.data(),
+                   steps.data(), active.data(),
+                   active.size()};
+    DragStepKernel step = fast ? activeDragKernel().fastStep : activeDragKernel().step;
+    while (step(l, NUMERICAL_DT) > 0) {}
+}
+
+void BatchSimulator::run(const ProjectileBatch& batch, BatchResults& results, size_t begin, size_t end) {
+    PROFILE_SCOPE("batch.run");
+    PROFILE_COUNT("batch.launches", end - begin);
+    for (size_t tileBegin = begin; tileBegin < end; tileBegin += TILE) {
+        size_t tileEnd = std::min(tileBegin + TILE, end);
+
+        for (size_t k = tileBegin; k < tileEnd; k++) {
+            if (batch.airResistance[k]) continue;
+            TrajectoryMetrics metrics = analyticalMetrics(batch.initialVelocity[k],
+                                                          batch.angle[k], batch.gravity[k]);
+            results.maxHeight[k] = metrics.maxHeight;
+            results.range[k] = metrics.range;
+            results.flightTime[k] = metrics.flightTime;
+        }
+
+        // Adaptive launches take their own step sizes, so they cannot be
+        // stepped in lockstep and run one at a time instead, as do Euler
+        // launches in a precision the lockstep kernels do not provide
+        for (size_t k = tileBegin; k < tileEnd; k++) {
+            if (!batch.airResistance[k] || (batch.integrator[k] == Integrator::Euler &&
+                                            batch.precision[k] == FloatPrecision::Single)) continue;
+            TrajectoryMetrics metrics = batch.integrator[k] == Integrator::DormandPrince
+                ? dormandPrinceMetrics(batch.get(k)) : emittedMetrics(batch.get(k));
+            results.maxHeight[k] = metrics.maxHeight;
+            results.range[k] = metrics.range;
+            results.flightTime[k] = metrics.flightTime;
+        }
+
+        // Euler launches step in lockstep, exact and fastDrag lanes in
+        // separate passes
+        for (int fast = 0; fast < 2; fast++) {
+            lanes.clear();
+            for (size_t k = tileBegin; k < tileEnd; k++) {
+                if (batch.airResistance[k] && batch.integrator[k] == Integrator::Euler &&
+                    batch.precision[k] == FloatPrecision::Single && batch.fastDrag[k] == fast) {
+                    lanes.push_back(k);
+                }
+            }
+            if (!lanes.empty()) {
+                gather(batch);
+                stepNumerical(fast != 0);
+                scatter(results);
+            }
+        }
+    }
+}
+
+bool GriddedWind::load(std::istream& in, std::unique_ptr<GriddedWind>& field, std::string& error) {
+    std::stringstream values;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+        values << line << '\n';
+    }
+
+    int count[3];
+    float o[3], d[3];
+    if (!(values >> count[0] >> count[1] >> count[2] >> o[0] >> o[1] >> o[2] >> d[0] >> d[1] >> d[2]) ||
+        count[0] < 1 || count[1] < 1 || count[2] < 1 || !(d[0] > 0 && d[1] > 0 && d[2] > 0) ||
+        (double)count[0] * count[1] * count[2] > 1e8) {
+        error = "expected a header 'nx ny nz x0 y0 z0 dx dy dz' with positive counts and spacing";
+        return false;
+    }
+    field.reset(new GriddedWind(count[0], count[1], count[2], Vector3D(o[0], o[1], o[2]),
+                                Vector3D(d[0], d[1], d[2])));
+    for (int k = 0; k < count[2]; k++) {
+        for (int j = 0; j < count[1]; j++) {
+            for (int i = 0; i < count[0]; i++) {
+                Vector3D wind;
+                if (!(values >> wind.x >> wind.y >> wind.z)) {
+                    error = "expected " + std::to_string((size_t)count[0] * count[1] * count[2]) +
+                            " node velocities 'u v w'";
+                    return false;
+                }
+                field->set(i, j, k, wind);
+            }
+        }
+    }
+    return true;
+}
+
+void EnvironmentSimulator::gather(const ProjectileBatch& batch, size_t begin, size_t end) {
+    size_t n = end - begin;
+    for (auto* v : {&x, &y, &z, &vx, &vy, &vz, &gravity, &dragCoefficient, &mass, &headingX, &headingZ,
+                    &maxY, &altitude, &density, &windX, &windY, &windZ}) {
+        v->assign(n, 0);
+    }
+    lanes.resize(n);
+    steps.assign(n, 0);
+    landed.assign(n, 0);
+
+    for (size_t i = 0; i < n; i++) {
+        size_t k = begin + i;
+        lanes[i] = k;
+        float angleRad = batch.angle[k] * PI / 180.0f;
+        float azimuthRad = batch.azimuth[k] * PI / 180.0f;
+        float horizontal = batch.initialVelocity[k] * cos(angleRad);
+        headingX[i] = cos(azimuthRad);
+        headingZ[i] = sin(azimuthRad);
+        vx[i] = horizontal * headingX[i];
+        vy[i] = batch.initialVelocity[k] * sin(angleRad);
+        vz[i] = horizontal * headingZ[i];
+        gravity[i] = batch.gravity[k];
+        dragCoefficient[i] = batch.airResistance[k] ? batch.dragCoefficient[k] : 0;
+        mass[i] = batch.mass[k];
+    }
+}
+
+void EnvironmentSimulator::finish(size_t i, float impactX, float impactZ, float time, EnvironmentResults& results) {
+    size_t k = lanes[i];
+    results.maxHeight[k] = maxY[i];
+    results.range[k] = impactX * headingX[i] + impactZ * headingZ[i];
+    results.drift[k] = impactZ * headingX[i] - impactX * headingZ[i];
+    results.flightTime[k] = time;
+    landed[i] = 1;
+}
+
+size_t EnvironmentSimulator::compact(size_t n) {
+    size_t live = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (landed[i]) continue;
+        if (live != i) {
+            lanes[live] = lanes[i];
+            for (auto* v : {&x, &y, &z, &vx, &vy, &vz, &gravity, &dragCoefficient, &mass,
+                            &headingX, &headingZ, &maxY}) {
+                (*v)[live] = (*v)[i];
+            }
+            steps[live] = steps[i];
+        }
+        landed[live] = 0;
+        live++;
+    }
+    return live;
+}
+
+void EnvironmentSimulator::step(size_t n, const Environment& environment, float dt, EnvironmentResults& results) {
+    if (environment.atmosphere) {
+        for (size_t i = 0; i < n; i++) altitude[i] = environment.groundAltitude + y[i];
+        environment.atmosphere->density(altitude.data(), density.data(), n);
+    } else {
+        std::fill(density.begin(), density.begin() + n, AIR_DENSITY);
+    }
+    if (environment.wind) {
+        environment.wind->velocity(x.data(), y.data(), z.data(), windX.data(), windY.data(), windZ.data(), n);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        float px = x[i], py = y[i], pz = z[i];
+        if (py > maxY[i]) maxY[i] = py;
+        steps[i]++;
+
+        float rx = vx[i] - windX[i], ry = vy[i] - windY[i], rz = vz[i] - windZ[i];
+        float speed = sqrt(rx * rx + ry * ry + rz * rz);
+        float dragForce = 0.5f * density[i] * dragCoefficient[i] * CROSS_SECTION_AREA * speed * speed;
+        float dragAccelX = 0, dragAccelY = 0, dragAccelZ = 0;
+        if (speed > 0.001f) {
+            dragAccelX = -(dragForce / mass[i]) * (rx / speed);
+            dragAccelY = -(dragForce / mass[i]) * (ry / speed);
+            dragAccelZ = -(dragForce / mass[i]) * (rz / speed);
+        }
+
+        vx[i] += dragAccelX * dt;
+        vy[i] += (dragAccelY - gravity[i]) * dt;
+        vz[i] += dragAccelZ * dt;
+
+        x[i] += vx[i] * dt;
+        y[i] += vy[i] * dt;
+        z[i] += vz[i] * dt;
+
+        float startTime = (steps[i] - 1) * dt;
+        if (y[i] < 0) {
+            float fraction = py / (py - y[i]);
+            finish(i, px + fraction * (x[i] - px), pz + fraction * (z[i] - pz),
+                   startTime + fraction * dt, results);
+        } else if (steps[i] > MAX_NUMERICAL_STEPS) {
+            finish(i, px, pz, startTime + dt, results);
+        }
+    }
+}
+
+void EnvironmentSimulator::run(const ProjectileBatch& batch, const Environment& environment,
+                               EnvironmentResults& results, size_t begin, size_t end) {
+    PROFILE_SCOPE("environment.run");
+    PROFILE_COUNT("environment.launches", end - begin);
+    for (size_t tileBegin = begin; tileBegin < end; tileBegin += TILE) {
+        size_t tileEnd = std::min(tileBegin + TILE, end);
+        gather(batch, tileBegin, tileEnd);
+        for (size_t live = tileEnd - tileBegin; live > 0; ) {
+            step(live, environment, NUMERICAL_DT, results);
+            PROFILE_COUNT("environment.steps", live);
+            live = compact(live);
+        }
+    }
+}
+
+bool PresetRegistry::loadFile(const std::string& path, std::string& error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "cannot open preset file";
+        return false;
+    }
+    return load(file, error);
+}
+
+bool PresetRegistry::load(std::istream& in, std::string& error) {
+    std::string line;
+    for (int lineNumber = 1; std::getline(in, line); lineNumber++) {
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+        std::istringstream fields(line);
+        EnvironmentPreset preset{"", 0, 0, 0};
+        if (!(fields >> preset.name)) continue;
+
+        std::string extra;
+        if (!(fields >> preset.gravity) || !(preset.gravity > 0) ||
+            (!(fields >> preset.airDensity) && !fields.eof()) ||
+            (!(fields >> preset.scaleHeight) && !fields.eof()) || (fields >> extra) ||
+            preset.airDensity < 0 || preset.scaleHeight < 0) {
+            error = "line " + std::to_string(lineNumber) +
+                    ": expected 'name gravity [density [scale_height]]' with gravity > 0";
+            return false;
+        }
+        if (!add(preset, error)) {
+            error = "line " + std::to_string(lineNumber) + ": " + error;
+            return false;
+        }
+    }
+    if (presets.empty()) {
+        error = "no presets";
+        return false;
+    }
+    return true;
+}
+
+const PresetRegistry* PresetRegistry::create() {
+    inUse() = true;
+    if (pending()) return pending().release();
+    return new PresetRegistry(builtin());
+}
+
+bool PresetRegistry::initializeFromEnvironment(std::string& error) {
+    const char* path = std::getenv("PROJECTILE_PRESETS");
+    if (!path || !*path) return true;
+    return initialize(path, error);
+}
+
+#ifdef PROJECTILE_CUDA
+static DeviceDistribution deviceDistribution(const ParameterDistribution& distribution) {
+    return {distribution.kind == ParameterDistribution::Normal ? 1
+            : distribution.kind == ParameterDistribution::Uniform ? 2 : 0,
+            distribution.first, distribution.second};
+}
+
+// Runs ensembles with projectile-cuda.cu: one launch per device thread,
+// reduced on the device. Drag launches that are not Euler in single
+// precision, and ensembles the device fails to run, go to the cpu backend,
+// so run() always returns the summary.
+class CudaEnsembleBackend : public EnsembleBackend {
+private:
+    CpuEnsembleBackend fallback;
+
+public:
+    explicit CudaEnsembleBackend(unsigned threads) : fallback(threads) {}
+
+    const char* name() const override { return "cuda"; }
+
+    EnsembleSummary run(const EnsembleSpec& spec) override {
+        PROFILE_SCOPE("ensemble.cuda");
+        const ProjectileData& nominal = spec.nominal;
+        if (nominal.airResistance && (nominal.integrator != Integrator::Euler ||
+                                      nominal.precision != FloatPrecision::Single)) {
+            return fallback.run(spec);
+        }
+
+        DeviceEnsemble ensemble;
+        ensemble.initialVelocity = nominal.initialVelocity;
+        ensemble.angle = nominal.angle;
+        ensemble.gravity = nominal.gravity;
+        ensemble.dragCoefficient = nominal.dragCoefficient;
+        ensemble.mass = nominal.mass;
+        ensemble.airResistance = nominal.airResistance;
+        ensemble.fastDrag = nominal.fastDrag;
+        ensemble.velocity = deviceDistribution(spec.velocity);
+        ensemble.angleDistribution = deviceDistribution(spec.angle);
+        ensemble.dragDistribution = deviceDistribution(spec.dragCoefficient);
+        ensemble.massDistribution = deviceDistribution(spec.mass);
+        ensemble.count = spec.count;
+        ensemble.seed = spec.seed;
+        ensemble.pi = PI;
+        ensemble.airDensity = AIR_DENSITY;
+        ensemble.crossSectionArea = CROSS_SECTION_AREA;
+        ensemble.dt = NUMERICAL_DT;
+        ensemble.maxSteps = MAX_NUMERICAL_STEPS;
+
+        EnsembleSummary summary = spec.emptySummary();
+        ensemble.aimPoint = summary.aimPoint;
+        EnsembleMetric* metrics[DEVICE_METRICS] = {&summary.maxHeight, &summary.range, &summary.flightTime,
+                                                   &summary.miss};
+        DeviceMetric device[DEVICE_METRICS];
+        for (int m = 0; m < DEVICE_METRICS; m++) {
+            const Histogram& h = metrics[m]->histogram;
+            device[m].histogram = {h.lo, h.hi, h.bins, 0, 0};
+        }
+
+        std::string error;
+        if (!runCudaEnsemble(ensemble, device, error)) return fallback.run(spec);
+
+        for (int m = 0; m < DEVICE_METRICS; m++) {
+            RunningStatistics& statistics = metrics[m]->statistics;
+            statistics.count = device[m].count;
+            statistics.mean = device[m].mean;
+            statistics.m2 = device[m].m2;
+            statistics.min = device[m].min;
+            statistics.max = device[m].max;
+            Histogram& h = metrics[m]->histogram;
+            h.bins = device[m].histogram.bins;
+            h.underflow = device[m].histogram.underflow;
+            h.overflow = device[m].histogram.overflow;
+        }
+        return summary;
+    }
+};
+#endif
+
+std::unique_ptr<EnsembleBackend> makeEnsembleBackend(const std::string& name, unsigned threads,
+                                                     std::string& error) {
+    if (name == "cpu") return std::unique_ptr<EnsembleBackend>(new CpuEnsembleBackend(threads));
+#ifdef PROJECTILE_CUDA
+    if (name == "cuda") {
+        if (!cudaEnsembleAvailable(error)) return nullptr;
+        return std::unique_ptr<EnsembleBackend>(new CudaEnsembleBackend(threads));
+    }
+    error = "unknown ensemble backend '" + name + "' (available: cpu, cuda)";
+#else
+    error = "unknown ensemble backend '" + name + "' (available: cpu)";
+#endif
+    return nullptr;
+}
+
+std::string SweepShard::path(const std::string& directory) const {
+    char name[64];
+    std::snprintf(name, sizeof(name), "shard-%05llu-of-%05llu.pmt",
+                  (unsigned long long)index, (unsigned long long)count);
+    return directory.empty() ? std::string(name) : directory + "/" + name;
+}
+
+ProjectileBatch selectShard(const ProjectileBatch& batch, SweepShard shard) {
+    ProjectileBatch selected;
+    selected.reserve((size_t)shard.size(batch.size()));
+    for (size_t i = (size_t)shard.index; i < batch.size(); i += (size_t)shard.count) selected.add(batch.get(i));
+    return selected;
+}
+
+ProjectileBatch selectShard(const SweepGrid& grid, SweepShard shard) {
+    ProjectileBatch selected;
+    selected.reserve((size_t)shard.size(grid.size()));
+    for (uint64_t i = shard.index; i < grid.size(); i += shard.count) selected.add(grid.launch((size_t)i));
+    return selected;
+}
+
+ProjectileBatch selectShard(const EnsembleSpec& spec, SweepShard shard) {
+    ProjectileBatch selected;
+    selected.reserve((size_t)shard.size(spec.count));
+    for (uint64_t i = shard.index; i < spec.count; i += shard.count) selected.add(spec.launch(i));
+    return selected;
+}
+
+// FNV-1a, fed field by field so struct padding never enters the hash
+static void hashBytes(uint64_t& hash, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 1099511628211ull;
+}
+
+template <typename T>
+static void hashValue(uint64_t& hash, T value) {
+    hashBytes(hash, &value, sizeof(value));
+}
+
+static void hashLaunch(uint64_t& hash, const ProjectileData& data) {
+    hashValue(hash, data.initialVelocity);
+    hashValue(hash, data.angle);
+    hashValue(hash, data.gravity);
+    hashValue(hash, (uint8_t)data.airResistance);
+    hashValue(hash, data.dragCoefficient);
+    hashValue(hash, data.mass);
+    hashValue(hash, (uint8_t)data.integrator);
+    hashValue(hash, data.tolerance);
+    hashValue(hash, (uint8_t)data.fastDrag);
+    hashValue(hash, (uint8_t)data.precision);
+    hashValue(hash, data.azimuth);
+}
+
+static void hashAxis(uint64_t& hash, const SweepAxis& axis) {
+    hashValue(hash, axis.first);
+    hashValue(hash, axis.last);
+    hashValue(hash, axis.count);
+}
+
+static void hashDistribution(uint64_t& hash, const ParameterDistribution& distribution) {
+    hashValue(hash, (uint8_t)distribution.kind);
+    hashValue(hash, distribution.first);
+    hashValue(hash, distribution.second);
+}
+
+static uint64_t fingerprintStart(uint64_t shardCount, uint8_t kind) {
+    uint64_t hash = 14695981039346656037ull;
+    hashValue(hash, shardCount);
+    hashValue(hash, kind);
+    return hash;
+}
+
+static uint64_t fingerprintEnd(uint64_t hash) {
+    return hash ? hash : 1;
+}
+
+uint64_t sweepFingerprint(const ProjectileBatch& launches, uint64_t shardCount) {
+    uint64_t hash = fingerprintStart(shardCount, 0);
+    hashValue(hash, (uint64_t)launches.size());
+    for (size_t i = 0; i < launches.size(); i++) hashLaunch(hash, launches.get(i));
+    return fingerprintEnd(hash);
+}
+
+uint64_t sweepFingerprint(const SweepGrid& grid, const ProjectileData& settings, uint64_t shardCount) {
+    uint64_t hash = fingerprintStart(shardCount, 1);
+    hashAxis(hash, grid.velocity);
+    hashAxis(hash, grid.angle);
+    hashAxis(hash, grid.gravity);
+    hashAxis(hash, grid.dragCoefficient);
+    hashValue(hash, (uint8_t)grid.airResistance);
+    hashValue(hash, grid.mass);
+    hashValue(hash, (uint8_t)settings.integrator);
+    hashValue(hash, settings.tolerance);
+    hashValue(hash, (uint8_t)settings.fastDrag);
+    hashValue(hash, (uint8_t)settings.precision);
+    hashValue(hash, settings.azimuth);
+    return fingerprintEnd(hash);
+}
+
+uint64_t sweepFingerprint(const EnsembleSpec& spec, uint64_t shardCount) {
+    uint64_t hash = fingerprintStart(shardCount, 2);
+    hashLaunch(hash, spec.nominal);
+    hashDistribution(hash, spec.velocity);
+    hashDistribution(hash, spec.angle);
+    hashDistribution(hash, spec.dragCoefficient);
+    hashDistribution(hash, spec.mass);
+    hashValue(hash, spec.count);
+    hashValue(hash, spec.seed);
+    return fingerprintEnd(hash);
+}
+
+bool shardComplete(const std::string& directory, SweepShard shard, const ProjectileBatch& launches) {
+    TrajectoryFileReader reader;
+    std::string error;
+    if (!reader.open(shard.path(directory), error) || reader.fingerprint() != shard.fingerprint ||
+        reader.launchCount() != launches.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < launches.size(); i++) {
+        ProjectileData stored = reader.record(i).launch(), expected = launches.get(i);
+        if (stored.initialVelocity != expected.initialVelocity || stored.angle != expected.angle ||
+            stored.gravity != expected.gravity || stored.airResistance != expected.airResistance ||
+            stored.dragCoefficient != expected.dragCoefficient || stored.mass != expected.mass ||
+            stored.integrator != expected.integrator || stored.tolerance != expected.tolerance ||
+            stored.fastDrag != expected.fastDrag || stored.precision != expected.precision) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool runShard(const std::string& directory, SweepShard shard, const ProjectileBatch& launches,
+              SweepRunner& runner, std::string& error) {
+    PROFILE_SCOPE("shard.run");
+    BatchResults results;
+    runner.run(launches, results);
+
+    // Unique per worker, so a duplicate worker on the same shard cannot
+    // interleave writes with this one
+    std::string path = shard.path(directory);
+#if !defined(_WIN32)
+    std::string partial = path + ".partial." + std::to_string((long long)getpid());
+#else
+    std::string partial = path + ".partial";
+#endif
+    TrajectoryFileWriter writer;
+    if (!writer.open(partial, TrajectoryEncoding::Raw, shard.fingerprint)) {
+        error = "cannot create '" + partial + "'";
+        return false;
+    }
+    for (size_t i = 0; i < launches.size(); i++) {
+        TrajectoryMetrics metrics;
+        metrics.maxHeight = results.maxHeight[i];
+        metrics.range = results.range[i];
+        metrics.flightTime = results.flightTime[i];
+        writer.add(launches.get(i), metrics);
+    }
+    if (!writer.close()) {
+        std::remove(partial.c_str());
+        error = "error writing '" + partial + "'";
+        return false;
+    }
+    if (std::rename(partial.c_str(), path.c_str()) != 0) {
+        std::remove(partial.c_str());
+        error = "cannot rename '" + partial + "' to '" + path + "'";
+        return false;
+    }
+    return true;
+}
+
+static bool fileExists(const std::string& path) {
+#if !defined(_WIN32)
+    struct stat info;
+    return ::stat(path.c_str(), &info) == 0;
+#else
+    return std::ifstream(path).is_open();
+#endif
+}
+
+bool reduceShards(const std::string& directory, uint64_t count, size_t bins, const float* aimPoint,
+                  EnsembleSummary& summary, std::string& error) {
+    PROFILE_SCOPE("shard.reduce");
+    // First pass: the spans the histograms need, and the mean impact
+    RunningStatistics span[3];
+    std::string missing, unreadable;
+    uint64_t fingerprint = 0;
+    for (uint64_t s = 0; s < count; s++) {
+        TrajectoryFileReader reader;
+        std::string openError;
+        std::string path = SweepShard(s, count).path(directory);
+        if (!reader.open(path, openError)) {
+            if (fileExists(path)) {
+                unreadable += (unreadable.empty() ? "" : "; ") + path + ": " + openError;
+            } else {
+                missing += (missing.empty() ? "" : ", ") + std::to_string((unsigned long long)s);
+            }
+            continue;
+        }
+        if (reader.fingerprint() == 0) {
+            error = path + " has no sweep fingerprint";
+            return false;
+        }
+        if (fingerprint == 0) fingerprint = reader.fingerprint();
+        if (reader.fingerprint() != fingerprint) {
+            error = path + " belongs to a different sweep than the shards before it";
+            return false;
+        }
+        for (size_t i = 0; i < reader.launchCount(); i++) {
+            const TrajectoryFileRecord& r = reader.record(i);
+            span[0].add(r.maxHeight);
+            span[1].add(r.range);
+            span[2].add(r.flightTime);
+        }
+    }
+    if (!missing.empty() || !unreadable.empty()) {
+        error = missing.empty() ? "" : "shards not complete: " + missing;
+        if (!unreadable.empty()) {
+            error += (missing.empty() ? "" : "; ") + std::string("unreadable shards: ") + unreadable;
+        }
+        return false;
+    }
+
+    summary = EnsembleSummary();
+    summary.aimPoint = aimPoint ? *aimPoint : (float)span[1].mean;
+    if (span[0].count == 0) return true;
+    EnsembleMetric* metrics[3] = {&summary.maxHeight, &summary.range, &summary.flightTime};
+    for (int m = 0; m < 3; m++) {
+        metrics[m]->histogram = Histogram(span[m].min, std::nextafter(span[m].max, INFINITY), bins);
+    }
+    float farthest = std::max(std::fabs(span[1].min - summary.aimPoint), std::fabs(span[1].max - summary.aimPoint));
+    summary.miss.histogram = Histogram(0, std::nextafter(farthest, INFINITY), EnsembleSpec::MISS_BINS);
+
+    // Second pass, in shard order so the result does not depend on which
+    // worker ran which shard
+    for (uint64_t s = 0; s < count; s++) {
+        TrajectoryFileReader reader;
+        if (!reader.open(SweepShard(s, count).path(directory), error)) return false;
+        for (size_t i = 0; i < reader.launchCount(); i++) {
+            const TrajectoryFileRecord& r = reader.record(i);
+            summary.add(r.maxHeight, r.range, r.flightTime);
+        }
+    }
+    return true;
+}
+
+// Brent's minimizer applied to -f: golden-section steps, replaced by
+// parabolic interpolation once f looks smooth. Returns the maximizer in
+// [a, b] to within about tolerance.
+template <typename F>
+double brentMaximize(F f, double a, double b, double tolerance, double& best) {
+    const double GOLDEN = 0.3819660112501051;
+    double x = a + GOLDEN * (b - a), w = x, v = x;
+    double fx = -f(x), fw = fx, fv = fx;
+    double d = 0, e = 0;
+
+    for (int iteration = 0; iteration < 100; iteration++) {
+        double middle = 0.5 * (a + b);
+        double tol1 = 1e-10 * std::fabs(x) + tolerance / 3;
+        double tol2 = 2 * tol1;
+        if (std::fabs(x - middle) <= tol2 - 0.5 * (b - a)) break;
+
+        bool golden = true;
+        if (std::fabs(e) > tol1) {
+            double r = (x - w) * (fx - fv);
+            double q = (x - v) * (fx - fw);
+            double p = (x - v) * q - (x - w) * r;
+            q = 2 * (q - r);
+            if (q > 0) p = -p;
+            else q = -q;
+            double previous = e;
+            e = d;
+            if (std::fabs(p) < std::fabs(0.5 * q * previous) && p > q * (a - x) && p < q * (b - x)) {
+                d = p / q;
+                double u = x + d;
+                if (u - a < tol2 || b - u < tol2) d = x < middle ? tol1 : -tol1;
+                golden = false;
+            }
+        }
+        if (golden) {
+            e = (x < middle ? b : a) - x;
+            d = GOLDEN * e;
+        }
+
+        double u = x + (std::fabs(d) >= tol1 ? d : (d > 0 ? tol1 : -tol1));
+        double fu = -f(u);
+        if (fu <= fx) {
+            if (u < x) b = x;
+            else a = x;
+            v = w; fv = fw;
+            w = x; fw = fx;
+            x = u; fx = fu;
+        } else {
+            if (u < x) a = u;
+            else b = u;
+            if (fu <= fw || w == x) {
+                v = w; fv = fw;
+                w = u; fw = fu;
+            } else if (fu <= fv || v == x || v == w) {
+                v = u; fv = fu;
+            }
+        }
+    }
+    best = -fx;
+    return x;
+}
+
+// Brent's root finder on a bracket with f(a) and f(b) of opposite sign.
+// Keeps the bracket, so it degrades to bisection where f is not smooth.
+template <typename F>
+double brentRoot(F f, double a, double b, double fa, double fb, double tolerance) {
+    double c = a, fc = fa, d = b - a, e = d;
+
+    for (int iteration = 0; iteration < 100; iteration++) {
+        if ((fb > 0) == (fc > 0)) {
+            c = a; fc = fa;
+            d = e = b - a;
+        }
+        if (std::fabs(fc) < std::fabs(fb)) {
+            a = b; b = c; c = a;
+            fa = fb; fb = fc; fc = fa;
+        }
+
+        double tol1 = 1e-10 * std::fabs(b) + tolerance / 2;
+        double middle = 0.5 * (c - b);
+        if (std::fabs(middle) <= tol1 || fb == 0) break;
+
+        if (std::fabs(e) >= tol1 && std::fabs(fa) > std::fabs(fb)) {
+            double s = fb / fa, p, q;
+            if (a == c) {
+                p = 2 * middle * s;
+                q = 1 - s;
+            } else {
+                double qa = fa / fc, r = fb / fc;
+                p = s * (2 * middle * qa * (qa - r) - (b - a) * (r - 1));
+                q = (qa - 1) * (r - 1) * (s - 1);
+            }
+            if (p > 0) q = -q;
+            else p = -p;
+            if (2 * p < std::min(3 * middle * q - std::fabs(tol1 * q), std::fabs(e * q))) {
+                e = d;
+                d = p / q;
+            } else {
+                d = e = middle;
+            }
+        } else {
+            d = e = middle;
+        }
+
+        a = b; fa = fb;
+        b += std::fabs(d) > tol1 ? d : (middle > 0 ? tol1 : -tol1);
+        fb = f(b);
+    }
+    return b;
+}
+
+// Height of the trajectory where it passes distance x, interpolated
+// between states. A launch that lands short reports -(x - range), which is
+// continuous with the heights of launches that just reach x.
+class HeightAtDistanceSink : public TrajectorySink {
+private:
+    float distance;
+    TrajectoryState previous;
+
+public:
+    bool reached;
+    float height;
+
+    explicit HeightAtDistanceSink(float distance) : distance(distance), previous(), reached(false), height(0) {}
+
+    void begin(const ProjectileData&) override {
+        reached = false;
+        height = 0;
+    }
+
+    void push(const TrajectoryState& state) override {
+        if (reached) return;
+        if (state.x >= distance) {
+            float span = state.x - previous.x;
+            float fraction = span > 0 ? (distance - previous.x) / span : 1.0f;
+            height = previous.y + fraction * (state.y - previous.y);
+            reached = true;
+        }
+        previous = state;
+    }
+
+    void end() override {
+        if (!reached) height = -(distance - previous.x);
+    }
+};
+
+AngleSolution solveOptimalAngle(const ProjectileData& launch, float tolerance) {
+    PROFILE_SCOPE("solver.optimal_angle");
+    AngleSolution solution = AngleSolution();
+    ProjectileData data = launch;
+    if (!data.airResistance) {
+        data.angle = 45.0f;
+        solution.found = data.initialVelocity > 0 && data.gravity > 0;
+        solution.angle = data.angle;
+        solution.metrics = ProjectileSimulator(data).calculateMetrics();
+        return solution;
+    }
+
+    auto range = [&](double angle) {
+        data.angle = (float)angle;
+        solution.evaluations++;
+        PROFILE_COUNT("solver.evaluations", 1);
+        return (double)ProjectileSimulator(data).calculateMetrics().range;
+    };
+
+    double best;
+    data.angle = (float)brentMaximize(range, 0.0, 90.0, tolerance, best);
+    solution.found = best > 0;
+    solution.angle = data.angle;
+    solution.metrics = ProjectileSimulator(data).calculateMetrics();
+    return solution;
+}
+
+AngleSolution solveAngleForTarget(const ProjectileData& launch, float targetX, float targetY,
+                                  bool highArc, float tolerance) {
+    PROFILE_SCOPE("solver.target_angle");
+    AngleSolution solution = AngleSolution();
+    if (targetX <= 0 || targetY < 0) return solution;
+
+    ProjectileData data = launch;
+    auto miss = [&](double angle) {
+        data.angle = (float)angle;
+        solution.evaluations++;
+        PROFILE_COUNT("solver.evaluations", 1);
+        if (!data.airResistance) {
+            double theta = angle * PI / 180.0;
+            double vx = data.initialVelocity * std::cos(theta);
+            double vy = data.initialVelocity * std::sin(theta);
+            if (vx <= 0) return -(double)targetX - targetY;
+            double t = targetX / vx;
+            return vy * t - 0.5 * data.gravity * t * t - targetY;
+        }
+        HeightAtDistanceSink sink(targetX);
+        ProjectileSimulator(data).simulate(sink, MAX_NUMERICAL_STEPS);
+        return (double)sink.height - targetY;
+    };
+
+    // The height at targetX rises and then falls with the angle; the low
+    // and high arcs are the roots on either side of its peak
+    double peak;
+    double peakAngle = brentMaximize(miss, 0.0, 90.0, tolerance, peak);
+    if (peak < 0) return solution;
+
+    double lo = highArc ? peakAngle : 0.0;
+    double hi = highArc ? 90.0 : peakAngle;
+    double flo = highArc ? peak : miss(lo);
+    double fhi = highArc ? miss(hi) : peak;
+    if ((flo > 0) == (fhi > 0)) return solution;
+
+    data.angle = (float)brentRoot(miss, lo, hi, flo, fhi, tolerance);
+    solution.found = true;
+    solution.angle = data.angle;
+    solution.metrics = ProjectileSimulator(data).calculateMetrics();
+    return solution;
+}
+
+bool parseFloat(const std::string& text, float& value) {
+    char* end = nullptr;
+    value = std::strtof(text.c_str(), &end);
+    return !text.empty() && end == text.c_str() + text.size();
+}
+
+bool parseCount(const std::string& text, uint64_t& value) {
+    char* end = nullptr;
+    value = std::strtoull(text.c_str(), &end, 10);
+    return !text.empty() && text[0] != '-' && end == text.c_str() + text.size();
+}
+
+bool parseIntegrator(const std::string& text, Integrator& integrator) {
+    if (text == "euler") {
+        integrator = Integrator::Euler;
+    } else if (text == "rk45") {
+        integrator = Integrator::DormandPrince;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool launchValuesValid(float velocity, float angle, float gravity, float dragCoefficient, float mass) {
+    return std::isfinite(velocity) && std::isfinite(angle) && std::isfinite(gravity) &&
+           std::isfinite(dragCoefficient) && std::isfinite(mass) &&
+           gravity > 0 && dragCoefficient >= 0 && mass > 0;
+}
+
+bool parseLaunchSpec(std::string line, ProjectileData& data, bool& blank) {
+    size_t comment = line.find('#');
+    if (comment != std::string::npos) line.erase(comment);
+
+    std::istringstream fields(line);
+    std::vector<std::string> columns;
+    std::string column;
+    while (fields >> column) columns.push_back(column);
+    blank = columns.empty();
+    if (blank) return true;
+
+    data = ProjectileData();
+    float air = 0;
+    bool ok = columns.size() >= 2 && columns.size() <= 7 &&
+              parseFloat(columns[0], data.initialVelocity) &&
+              parseFloat(columns[1], data.angle) &&
+              (columns.size() < 3 || parseFloat(columns[2], data.gravity)) &&
+              (columns.size() < 4 || parseFloat(columns[3], air)) &&
+              (columns.size() < 5 || parseFloat(columns[4], data.dragCoefficient)) &&
+              (columns.size() < 6 || parseFloat(columns[5], data.mass)) &&
+              (columns.size() < 7 || parseIntegrator(columns[6], data.integrator)) &&
+              std::isfinite(air) &&
+              launchValuesValid(data.initialVelocity, data.angle, data.gravity, data.dragCoefficient, data.mass);
+    data.airResistance = air != 0;
+    return ok;
+}
+
+bool loadLaunchFile(std::istream& in, ProjectileBatch& batch, std::string& error) {
+    std::string line;
+    for (int lineNumber = 1; std::getline(in, line); lineNumber++) {
+        ProjectileData data;
+        bool blank;
+        if (!parseLaunchSpec(line, data, blank)) {
+            error = "line " + std::to_string(lineNumber) + ": expected " + LAUNCH_SPEC_FORMAT;
+            return false;
+        }
+        if (!blank) batch.add(data);
+    }
+    return true;
+}
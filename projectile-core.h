@@ -0,0 +1,3685 @@
+// Projectile motion simulation library. Everything here is usable without
+// the interactive program: launch parameters (ProjectileData), single
+// launches (ProjectileSimulator, simulateLaunch), batched and threaded
+// sweeps (BatchSimulator, SweepRunner), 3D environments, ensembles, angle
+// solvers, trajectory files and sinks, asynchronous launches
+// (AsyncSimulator) and the socket server (SimulationServer). Most types are
+// header-defined; the library (projectile-core.cpp, projectile-server.cpp)
+// holds the out-of-line functions, the drag kernels and everything that
+// needs POSIX headers. The library does not use <iostream> (only the
+// PROJECTILE_PROFILE report may go to stderr); errors are returned to the
+// caller.
+#ifndef PROJECTILE_CORE_H
+#define PROJECTILE_CORE_H
+
+#include <istream>
+#include <ostream>
+#include <cmath>
+#include <vector>
+#include <iosfwd>
+#include <algorithm>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <queue>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <list>
+#include <unordered_map>
+#include <type_traits>
+#include <cstring>
+#include <cstdio>
+#include <charconv>
+#include <numeric>
+#include <cctype>
+#include <chrono>
+#include <exception>
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define PROJECTILE_COROUTINES 1
+#endif
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+const float PI = 3.14159265f;
+const double PI_DOUBLE = 3.14159265358979323846; // PI is this rounded to float
+const float AIR_DENSITY = 1.225f;
+const float CROSS_SECTION_AREA = 0.01f;
+
+// Instrumentation. Building with -DPROJECTILE_PROFILE compiles in phase
+// timers (PROFILE_SCOPE) and event counters (PROFILE_COUNT); without it
+// both macros expand to nothing. A profiling build records only when the
+// PROJECTILE_PROFILE environment variable names an output file ("-" for
+// stderr), and writes every timer and counter to it as JSON at exit.
+// Timers are inclusive, so nested phases are also counted in their parents.
+#ifdef PROJECTILE_PROFILE
+#include <chrono>
+
+struct ProfileEntry {
+    const char* name;
+    bool timer;
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> total; // nanoseconds for timers, the sum for counters
+    ProfileEntry* next;
+
+    ProfileEntry(const char* name, bool timer) : name(name), timer(timer), calls(0), total(0), next(nullptr) {}
+
+    void add(uint64_t amount) {
+        calls.fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(amount, std::memory_order_relaxed);
+    }
+};
+
+// Registry of entries, keyed by name so every use of a name shares one
+// entry. Entries and the registry are never freed, so they outlive any
+// static object that records during shutdown.
+class Profiler {
+private:
+    std::mutex mutex;
+    ProfileEntry* head;
+    std::string path;
+    bool recording;
+
+    Profiler() : head(nullptr), recording(false) {
+        const char* env = std::getenv("PROJECTILE_PROFILE");
+        if (env && *env) {
+            path = env;
+            recording = true;
+            std::atexit([] { instance().dump(); });
+        }
+    }
+
+    static Profiler& instance() {
+        static Profiler* profiler = new Profiler();
+        return *profiler;
+    }
+
+public:
+    static bool enabled() {
+        static const bool on = instance().recording;
+        return on;
+    }
+
+    static ProfileEntry& entry(const char* name, bool timer) {
+        Profiler& p = instance();
+        std::lock_guard<std::mutex> lock(p.mutex);
+        for (ProfileEntry* e = p.head; e; e = e->next) {
+            if (std::strcmp(e->name, name) == 0) return *e;
+        }
+        ProfileEntry* e = new ProfileEntry(name, timer);
+        e->next = p.head;
+        p.head = e;
+        return *e;
+    }
+
+    // {"timers": {name: {"calls": n, "ns": t}, ...}, "counters": {name: {"calls": n, "total": s}, ...}}
+    void dump();
+};
+
+class ProfileTimer {
+private:
+    ProfileEntry* entry;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit ProfileTimer(ProfileEntry& e) : entry(Profiler::enabled() ? &e : nullptr) {
+        if (entry) start = std::chrono::steady_clock::now();
+    }
+
+    ~ProfileTimer() {
+        if (entry) {
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            entry->add((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+    }
+
+    ProfileTimer(const ProfileTimer&) = delete;
+    ProfileTimer& operator=(const ProfileTimer&) = delete;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+// Times the rest of the enclosing scope under name
+#define PROFILE_SCOPE(name)                                                                     \
+    static ProfileEntry& PROFILE_CONCAT(profileEntry_, __LINE__) = Profiler::entry(name, true); \
+    ProfileTimer PROFILE_CONCAT(profileTimer_, __LINE__)(PROFILE_CONCAT(profileEntry_, __LINE__))
+
+// Adds amount to the counter name; amount is not evaluated when disabled
+#define PROFILE_COUNT(name, amount)                                          \
+    do {                                                                     \
+        static ProfileEntry& profileEntry_ = Profiler::entry(name, false);   \
+        if (Profiler::enabled()) profileEntry_.add((uint64_t)(amount));      \
+    } while (0)
+#else
+#define PROFILE_SCOPE(name) do {} while (0)
+#define PROFILE_COUNT(name, amount) do {} while (0)
+#endif
+
+struct Vector2D {
+    float x, y;
+    Vector2D(float x = 0, float y = 0) : x(x), y(y) {}
+};
+
+// x downrange, y up, z to the right of the x axis
+struct Vector3D {
+    float x, y, z;
+    Vector3D(float x = 0, float y = 0, float z = 0) : x(x), y(y), z(z) {}
+};
+
+// Integration scheme used when air resistance is on
+enum class Integrator : unsigned char {
+    Euler,          // fixed 0.01 s explicit Euler steps
+    DormandPrince   // adaptive RK5(4), step size driven by tolerance
+};
+
+// Arithmetic a drag launch is integrated in (see the precision policies)
+enum class FloatPrecision : unsigned char {
+    Single,     // float state, the batch kernels' arithmetic
+    Double,     // double state, for reference runs
+    Compensated // float state with Kahan-compensated accumulation
+};
+
+struct ProjectileData {
+    float initialVelocity;
+    float angle; // in degrees
+    float gravity;
+    bool airResistance;
+    float dragCoefficient;
+    float mass;
+    Integrator integrator;
+    float tolerance; // per-step error target for the adaptive integrator
+    bool fastDrag;   // drag via approximate 1/sqrt (see fastRsqrt)
+    FloatPrecision precision;
+    float azimuth;   // heading in degrees from +x toward +z, for 3D runs only
+    
+    ProjectileData() : initialVelocity(50.0f), angle(45.0f), gravity(9.8f), 
+                       airResistance(false), dragCoefficient(0.47f), mass(1.0f),
+                       integrator(Integrator::Euler), tolerance(1e-4f), fastDrag(false),
+                       precision(FloatPrecision::Single), azimuth(0) {}
+};
+
+// Summary of one launch, computed without sampling the trajectory
+struct TrajectoryMetrics {
+    float maxHeight;
+    float range;
+    float flightTime;
+
+    TrajectoryMetrics() : maxHeight(0), range(0), flightTime(0) {}
+};
+
+// Exact apex, range and flight time of a drag-free launch from ground level
+inline TrajectoryMetrics analyticalMetrics(float initialVelocity, float angle, float gravity) {
+    TrajectoryMetrics metrics;
+
+    float angleRad = angle * PI / 180.0f;
+    float vx = initialVelocity * cos(angleRad);
+    float vy = initialVelocity * sin(angleRad);
+    if (vy <= 0 || gravity <= 0) return metrics;
+
+    metrics.flightTime = 2.0f * vy / gravity;
+    metrics.maxHeight = vy * vy / (2.0f * gravity);
+    metrics.range = vx * metrics.flightTime;
+    return metrics;
+}
+
+// Drag force per unit speed squared: 0.5 * rho * Cd * A
+inline float dragFactorFor(float dragCoefficient) {
+    return 0.5f * AIR_DENSITY * dragCoefficient * CROSS_SECTION_AREA;
+}
+
+// Approximate 1/sqrt(s) for the fastDrag update: the hardware estimate
+// refined by one Newton step on x86 (rsqrtss here, rsqrtps / rsqrt14ps in
+// the vector kernels) and two on NEON, or a bit-level seed with two Newton
+// steps elsewhere. Over normal s in [1e-6, 1e12] the relative error of
+// |v| = |v|^2 * fastRsqrt(|v|^2), and so of the drag acceleration, is
+// below 5e-7 with the hardware estimates and below 5e-6 with the portable
+// seed (both checked exhaustively on x86). Fast results therefore differ
+// slightly between kernels, unlike the exact ones.
+inline float fastRsqrt(float s) {
+    float half = 0.5f * s;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE__)
+    float r = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(s)));
+    return r * (1.5f - half * r * r);
+#else
+    uint32_t bits;
+    std::memcpy(&bits, &s, sizeof(bits));
+    bits = 0x5f375a86u - (bits >> 1);
+    float r;
+    std::memcpy(&r, &bits, sizeof(r));
+    r = r * (1.5f - half * r * r);
+    return r * (1.5f - half * r * r);
+#endif
+}
+
+const uint32_t MAX_NUMERICAL_STEPS = 10000;
+const float NUMERICAL_DT = 0.01f;
+
+// Position and velocity of a projectile under gravity and drag
+template <typename Real>
+struct BasicDragState {
+    Real x, y, vx, vy;
+};
+
+typedef BasicDragState<float> DragState;
+
+template <typename Real>
+BasicDragState<Real> addScaled(const BasicDragState<Real>& s, Real h, const BasicDragState<Real>& d) {
+    BasicDragState<Real> r;
+    r.x = s.x + h * d.x;
+    r.y = s.y + h * d.y;
+    r.vx = s.vx + h * d.vx;
+    r.vy = s.vy + h * d.vy;
+    return r;
+}
+
+// Cubic Hermite interpolation across one step of length h, at fraction u,
+// from endpoint values p0, p1 and their time derivatives d0, d1
+template <typename Real>
+Real hermite(Real p0, Real d0, Real p1, Real d1, Real h, Real u) {
+    Real h00 = (1 + 2 * u) * (1 - u) * (1 - u);
+    Real h10 = u * (1 - u) * (1 - u);
+    Real h01 = u * u * (3 - 2 * u);
+    Real h11 = u * u * (u - 1);
+    return h00 * p0 + h10 * h * d0 + h01 * p1 + h11 * h * d1;
+}
+
+// Time derivative of the same interpolant
+template <typename Real>
+Real hermiteSlope(Real p0, Real d0, Real p1, Real d1, Real h, Real u) {
+    Real g00 = 6 * u * (u - 1);
+    Real g10 = (1 - u) * (1 - 3 * u);
+    Real g01 = -g00;
+    Real g11 = u * (3 * u - 2);
+    return (g00 * p0 + g01 * p1) / h + g10 * d0 + g11 * d1;
+}
+
+// Locates the ground crossing inside a step from a (y >= 0) to b (y < 0) of
+// length h, using safeguarded Newton iterations on the Hermite interpolant
+// of y. Returns the interpolated state at the crossing with y = 0 and sets
+// fraction to the crossing time as a fraction of the step.
+template <typename Real>
+BasicDragState<Real> groundCrossing(const BasicDragState<Real>& a, const BasicDragState<Real>& aRate,
+                                    const BasicDragState<Real>& b, const BasicDragState<Real>& bRate,
+                                    Real h, Real& fraction) {
+    Real lo = 0, hi = 1;
+    Real u = a.y / (a.y - b.y);
+    for (int i = 0; i < 12; i++) {
+        Real value = hermite(a.y, aRate.y, b.y, bRate.y, h, u);
+        if (value > 0) lo = u; else hi = u;
+        if (std::fabs(value) < Real(1e-6f) * (1 + a.y)) break;
+
+        Real slope = hermiteSlope(a.y, aRate.y, b.y, bRate.y, h, u) * h;
+        Real next = slope != 0 ? u - value / slope : lo - 1;
+        u = (next > lo && next < hi) ? next : Real(0.5f) * (lo + hi);
+    }
+
+    fraction = u;
+    BasicDragState<Real> crossing;
+    crossing.x = hermite(a.x, aRate.x, b.x, bRate.x, h, u);
+    crossing.y = 0;
+    crossing.vx = a.vx + u * (b.vx - a.vx);
+    crossing.vy = a.vy + u * (b.vy - a.vy);
+    return crossing;
+}
+
+// One integrator state: time, position and velocity
+struct TrajectoryState {
+    float t, x, y, vx, vy;
+};
+
+// Statistics of a trajectory kept up to date as its states are produced,
+// so reading them never walks the stored points. The impact values are
+// those of the last state added.
+struct TrajectoryStats {
+    float maxHeight, apexTime;
+    float range, flightTime;
+    float impactVx, impactVy;
+
+    TrajectoryStats() : maxHeight(0), apexTime(0), range(0), flightTime(0), impactVx(0), impactVy(0) {}
+
+    void add(const TrajectoryState& state) {
+        if (state.y > maxHeight) {
+            maxHeight = state.y;
+            apexTime = state.t;
+        }
+        range = state.x;
+        flightTime = state.t;
+        impactVx = state.vx;
+        impactVy = state.vy;
+    }
+
+    float impactSpeed() const { return std::sqrt(impactVx * impactVx + impactVy * impactVy); }
+
+    // Degrees below the horizontal
+    float impactAngle() const { return std::atan2(-impactVy, impactVx) * (180.0f / PI); }
+};
+
+// Consumer of trajectory states as an integrator produces them, so callers
+// that only need a summary, a downsampled path or a file never hold the
+// whole trajectory. begin() is called before the launch state and end()
+// after the final (impact) state.
+class TrajectorySink {
+public:
+    virtual ~TrajectorySink() {}
+    virtual void begin(const ProjectileData&) {}
+    virtual void push(const TrajectoryState& state) = 0;
+    virtual void end() {}
+};
+
+// Upper bound on states per streamed run. Streaming keeps no storage, so
+// this only guards against launches that never come down (gravity <= 0).
+const uint32_t STREAMING_MAX_STEPS = 100000000;
+
+// Floating-point policies for SimulationKernel: the type the state is
+// integrated in, and how increments are accumulated into it. add() adds
+// term to sum, with carry holding the policy's running compensation for
+// that sum. Emitted states and results are float either way.
+struct SinglePrecision {
+    typedef float Real;
+    static constexpr bool COMPENSATED = false;
+
+    static void add(Real& sum, Real&, Real term) { sum += term; }
+};
+
+struct DoublePrecision {
+    typedef double Real;
+    static constexpr bool COMPENSATED = false;
+
+    static void add(Real& sum, Real&, Real term) { sum += term; }
+};
+
+// float state whose position, velocity and time sums are Kahan-compensated,
+// so the rounding of many small increments does not build up; close to
+// double accuracy over long flights at about twice the additions of
+// SinglePrecision. Relies on strict IEEE evaluation (no -ffast-math).
+struct CompensatedPrecision {
+    typedef float Real;
+    static constexpr bool COMPENSATED = true;
+
+    static void add(Real& sum, Real& carry, Real term) {
+        Real corrected = term - carry;
+        Real total = sum + corrected;
+        carry = (total - sum) - corrected;
+        sum = total;
+    }
+};
+
+template <typename Real>
+TrajectoryState stateOf(Real t, Real x, Real y, Real vx, Real vy) {
+    return TrajectoryState{(float)t, (float)x, (float)y, (float)vx, (float)vy};
+}
+
+// Drag models for SimulationKernel. Model<Real> takes the per-launch
+// constants once at construction and gives the drag acceleration for a
+// velocity, so the integrator loops read no launch data.
+struct NoDrag {
+    template <typename Real>
+    struct Model {
+        explicit Model(const ProjectileData&) {}
+
+        void acceleration(Real, Real, Real& ax, Real& ay) const {
+            ax = 0;
+            ay = 0;
+        }
+    };
+};
+
+// Quadratic drag in force form, the update the batch kernels perform
+struct QuadraticDrag {
+    template <typename Real>
+    struct Model {
+        Real dragFactor, mass;
+
+        explicit Model(const ProjectileData& data)
+            : dragFactor(Real(0.5f) * Real(AIR_DENSITY) * data.dragCoefficient * Real(CROSS_SECTION_AREA)),
+              mass(data.mass) {}
+
+        void acceleration(Real vx, Real vy, Real& ax, Real& ay) const {
+            Real speed = sqrt(vx * vx + vy * vy);
+            Real dragForce = dragFactor * speed * speed;
+            ax = 0;
+            ay = 0;
+            if (speed > Real(0.001f)) {
+                ax = -(dragForce / mass) * (vx / speed);
+                ay = -(dragForce / mass) * (vy / speed);
+            }
+        }
+    };
+};
+
+// Quadratic drag as -(k / m) |v| v with |v| from fastRsqrt(), the fastDrag
+// update of the batch kernels. In double precision |v| is exact.
+struct FastQuadraticDrag {
+    template <typename Real>
+    struct Model {
+        Real dragPerMass;
+
+        explicit Model(const ProjectileData& data)
+            : dragPerMass(Real(0.5f) * Real(AIR_DENSITY) * data.dragCoefficient * Real(CROSS_SECTION_AREA) /
+                          data.mass) {}
+
+        static float inverseSqrt(float s) { return fastRsqrt(s); }
+        static double inverseSqrt(double s) { return 1 / sqrt(s); }
+
+        void acceleration(Real vx, Real vy, Real& ax, Real& ay) const {
+            Real speedSquared = vx * vx + vy * vy;
+            Real speed = speedSquared * inverseSqrt(speedSquared);
+            ax = 0;
+            ay = 0;
+            if (speed > Real(0.001f)) {
+                Real dragPerSpeed = -dragPerMass * speed;
+                ax = dragPerSpeed * vx;
+                ay = dragPerSpeed * vy;
+            }
+        }
+    };
+};
+
+// Time derivative of a drag state under the given drag model
+template <typename Real, typename DragModel>
+BasicDragState<Real> dragDerivative(const BasicDragState<Real>& s, Real gravity, const DragModel& drag) {
+    BasicDragState<Real> d;
+    drag.acceleration(s.vx, s.vy, d.vx, d.vy);
+    d.x = s.vx;
+    d.y = s.vy;
+    d.vy -= gravity;
+    return d;
+}
+
+// Launch velocity components, using the same float arithmetic as the batch
+// kernels when Real is float
+template <typename Real>
+void launchVelocity(const ProjectileData& data, Real& vx, Real& vy) {
+    Real angleRad = Real(data.angle) * Real(PI_DOUBLE) / Real(180.0f);
+    vx = data.initialVelocity * cos(angleRad);
+    vy = data.initialVelocity * sin(angleRad);
+}
+
+// Integration methods for SimulationKernel. integrate() emits every state
+// from launch to impact and returns the flight time.
+
+// Drag-free flight sampled every 0.02 s, finishing with the exact impact.
+// Emits at most maxSteps + 1 samples; returns the final time (0 when the
+// launch never leaves the ground). Sample times come from the sample
+// index rather than a running sum, so they do not drift.
+struct AnalyticalMethod {
+    template <typename Precision, typename DragModel, typename Emit>
+    static float integrate(const ProjectileData& data, const DragModel&, uint32_t maxSteps, Emit&& emit) {
+        typedef typename Precision::Real Real;
+        Real vx, vy;
+        launchVelocity(data, vx, vy);
+        Real gravity = data.gravity;
+        
+        Real totalTime = 2 * vy / gravity;
+        Real dt = Real(0.02f);
+        
+        for (uint32_t index = 0; Real(index) * dt <= totalTime; index++) {
+            Real t = Real(index) * dt;
+            Real x = vx * t;
+            Real y = vy * t - Real(0.5f) * gravity * t * t;
+            
+            if (y < 0) break;
+            emit(stateOf<Real>(t, x, y, vx, vy - gravity * t));
+            if (index + 1 > maxSteps) return (float)t;
+        }
+        
+        // The sampling stops short of the ground; finish at the exact impact
+        if (vy > 0 && gravity > 0) {
+            emit(stateOf<Real>(totalTime, vx * totalTime, 0, vx, -vy));
+            return (float)totalTime;
+        }
+        return 0;
+    }
+};
+
+// Resumable position of an integrator after some steps. Euler uses steps,
+// t and s; Dormand-Prince also the next step size h and the derivative at
+// s (reused as the first stage of the next step). tCarry and carry are the
+// compensation terms of t and s under CompensatedPrecision. When finished,
+// t is the flight time.
+template <typename Real>
+struct IntegratorState {
+    uint32_t steps;
+    Real t, h, tCarry;
+    Real reach; // furthest end of any trial step, before clipping to an end time
+    BasicDragState<Real> s, rate, carry;
+    bool finished;
+};
+
+enum class AdvanceStatus {
+    Finished,   // landed or hit the step limit
+    Paused,     // reached the requested step count
+    ReachedTime // reached the requested end time
+};
+
+// Fixed-step explicit Euler, the same update as the batch kernels. Stops on
+// the exact ground crossing of the landing step or after maxSteps + 1
+// states; returns the flight time.
+struct EulerMethod {
+    static constexpr uint32_t CHECKPOINT_STEPS = 64;
+
+    template <typename Precision, typename DragModel, typename Emit>
+    static IntegratorState<typename Precision::Real> start(const ProjectileData& data, const DragModel&,
+                                                           Emit&& emit) {
+        typedef typename Precision::Real Real;
+        IntegratorState<Real> state = {};
+        launchVelocity(data, state.s.vx, state.s.vy);
+        emit(stateOf<Real>(0, 0, 0, state.s.vx, state.s.vy));
+        return state;
+    }
+
+    // Takes steps until the launch finishes, state.steps reaches stepLimit
+    // or the next step would start at or after endTime
+    template <typename Precision, typename DragModel, typename Emit>
+    static AdvanceStatus advance(IntegratorState<typename Precision::Real>& state, const ProjectileData& data,
+                                 const DragModel& drag, typename Precision::Real endTime, uint32_t stepLimit,
+                                 uint32_t maxSteps, Emit&& emit) {
+        typedef typename Precision::Real Real;
+        Real gravity = data.gravity;
+        Real dt = NUMERICAL_DT;
+        Real x = state.s.x, y = state.s.y, vx = state.s.vx, vy = state.s.vy;
+        BasicDragState<Real> carry = state.carry;
+        
+        for (uint32_t index = state.steps; ; index++) {
+            Real startTime = index * dt;
+            if (index >= stepLimit || startTime >= endTime) {
+                state.steps = index;
+                state.t = startTime;
+                state.s = BasicDragState<Real>{x, y, vx, vy};
+                state.carry = carry;
+                return index >= stepLimit ? AdvanceStatus::Paused : AdvanceStatus::ReachedTime;
+            }
+            Real px = x, py = y;
+            
+            Real dragAccelX, dragAccelY;
+            drag.acceleration(vx, vy, dragAccelX, dragAccelY);
+            
+            Precision::add(vx, carry.vx, dragAccelX * dt);
+            Precision::add(vy, carry.vy, (dragAccelY - gravity) * dt);
+            
+            Precision::add(x, carry.x, vx * dt);
+            Precision::add(y, carry.y, vy * dt);
+            
+            // Each Euler step moves in a straight line, so the ground
+            // crossing is found exactly by linear interpolation
+            if (y < 0) {
+                Real fraction = py / (py - y);
+                Real impactTime = startTime + fraction * dt;
+                emit(stateOf<Real>(impactTime, px + fraction * (x - px), 0, vx, vy));
+                state.steps = index + 1;
+                state.t = impactTime;
+                state.finished = true;
+                return AdvanceStatus::Finished;
+            }
+            if (index + 1 > maxSteps) {
+                state.steps = index + 1;
+                state.t = startTime + dt;
+                state.finished = true;
+                return AdvanceStatus::Finished;
+            }
+            emit(stateOf<Real>((index + 1) * dt, x, y, vx, vy));
+        }
+    }
+
+    // Nothing carries over between steps, so a new drag model needs no setup
+    template <typename Real, typename DragModel>
+    static void restart(IntegratorState<Real>&, const ProjectileData&, const DragModel&) {}
+
+    template <typename Precision, typename DragModel, typename Emit>
+    static float integrate(const ProjectileData& data, const DragModel& drag, uint32_t maxSteps, Emit&& emit) {
+        typedef typename Precision::Real Real;
+        IntegratorState<Real> state = start<Precision>(data, drag, emit);
+        advance<Precision>(state, data, drag, Real(INFINITY), UINT32_MAX, maxSteps, emit);
+        return (float)state.t;
+    }
+};
+
+// Dormand-Prince RK5(4) with FSAL and standard step-size control. Each
+// accepted state with y >= 0 is emitted, starting with the launch state.
+// When a step ends below ground, the exact crossing on that step's
+// interpolant is emitted as the final state (with y = 0). Stops there or
+// after maxSteps accepted steps; returns the final time.
+struct DormandPrinceMethod {
+    static constexpr uint32_t CHECKPOINT_STEPS = 4;
+
+    template <typename Precision, typename DragModel, typename Emit>
+    static IntegratorState<typename Precision::Real> start(const ProjectileData& data, const DragModel& drag,
+                                                           Emit&& emit) {
+        typedef typename Precision::Real Real;
+        IntegratorState<Real> state = {};
+        launchVelocity(data, state.s.vx, state.s.vy);
+        state.h = NUMERICAL_DT;
+        state.rate = dragDerivative(state.s, Real(data.gravity), drag);
+        emit(stateOf<Real>(0, 0, 0, state.s.vx, state.s.vy));
+        return state;
+    }
+
+    // Takes steps until the launch finishes, state.steps reaches stepLimit
+    // or state.t reaches endTime; the last step before endTime is shortened
+    // to end on it exactly
+    template <typename Precision, typename DragModel, typename Emit>
+    static AdvanceStatus advance(IntegratorState<typename Precision::Real>& state, const ProjectileData& data,
+                                 const DragModel& drag, typename Precision::Real endTime, uint32_t stepLimit,
+                                 uint32_t maxSteps, Emit&& emit) {
+        typedef typename Precision::Real Real;
+        typedef BasicDragState<Real> State;
+        const Real MIN_STEP = Real(1e-6f);
+        const Real MAX_STEP = 1;
+
+        Real g = data.gravity;
+        Real tol = data.tolerance;
+
+        State s = state.s;
+        State k1 = state.rate;
+        Real t = state.t;
+        Real h = state.h;
+        State carry = state.carry, nextCarry = carry;
+        Real tCarry = state.tCarry;
+        Real reach = state.reach;
+        AdvanceStatus status = AdvanceStatus::Finished;
+
+        for (uint32_t& accepted = state.steps; accepted < maxSteps; ) {
+            if (accepted >= stepLimit || t >= endTime) {
+                status = accepted >= stepLimit ? AdvanceStatus::Paused : AdvanceStatus::ReachedTime;
+                break;
+            }
+            // A rejected trial still shapes the next step size, so reach
+            // tells which end times the steps so far are independent of
+            reach = std::max(reach, t + h);
+            bool clipped = t + h >= endTime;
+            if (clipped) h = endTime - t;
+
+            State k2 = dragDerivative(addScaled(s, h * (Real(1) / 5), k1), g, drag);
+
+            State s3 = addScaled(s, h * (Real(3) / 40), k1);
+            s3 = addScaled(s3, h * (Real(9) / 40), k2);
+            State k3 = dragDerivative(s3, g, drag);
+
+            State s4 = addScaled(s, h * (Real(44) / 45), k1);
+            s4 = addScaled(s4, h * (Real(-56) / 15), k2);
+            s4 = addScaled(s4, h * (Real(32) / 9), k3);
+            State k4 = dragDerivative(s4, g, drag);
+
+            State s5 = addScaled(s, h * (Real(19372) / 6561), k1);
+            s5 = addScaled(s5, h * (Real(-25360) / 2187), k2);
+            s5 = addScaled(s5, h * (Real(64448) / 6561), k3);
+            s5 = addScaled(s5, h * (Real(-212) / 729), k4);
+            State k5 = dragDerivative(s5, g, drag);
+
+            State s6 = addScaled(s, h * (Real(9017) / 3168), k1);
+            s6 = addScaled(s6, h * (Real(-355) / 33), k2);
+            s6 = addScaled(s6, h * (Real(46732) / 5247), k3);
+            s6 = addScaled(s6, h * (Real(49) / 176), k4);
+            s6 = addScaled(s6, h * (Real(-5103) / 18656), k5);
+            State k6 = dragDerivative(s6, g, drag);
+
+            State next;
+            if (Precision::COMPENSATED) {
+                // The step's increment is formed on its own, then added
+                // to the compensated state
+                State delta;
+                delta.x = delta.y = delta.vx = delta.vy = 0;
+                delta = addScaled(delta, h * (Real(35) / 384), k1);
+                delta = addScaled(delta, h * (Real(500) / 1113), k3);
+                delta = addScaled(delta, h * (Real(125) / 192), k4);
+                delta = addScaled(delta, h * (Real(-2187) / 6784), k5);
+                delta = addScaled(delta, h * (Real(11) / 84), k6);
+                next = s;
+                nextCarry = carry;
+                Precision::add(next.x, nextCarry.x, delta.x);
+                Precision::add(next.y, nextCarry.y, delta.y);
+                Precision::add(next.vx, nextCarry.vx, delta.vx);
+                Precision::add(next.vy, nextCarry.vy, delta.vy);
+            } else {
+                next = addScaled(s, h * (Real(35) / 384), k1);
+                next = addScaled(next, h * (Real(500) / 1113), k3);
+                next = addScaled(next, h * (Real(125) / 192), k4);
+                next = addScaled(next, h * (Real(-2187) / 6784), k5);
+                next = addScaled(next, h * (Real(11) / 84), k6);
+            }
+            State k7 = dragDerivative(next, g, drag);
+
+            // Difference between the 5th and embedded 4th order solutions
+            State err;
+            err.x = err.y = err.vx = err.vy = 0;
+            err = addScaled(err, h * (Real(71) / 57600), k1);
+            err = addScaled(err, h * (Real(-71) / 16695), k3);
+            err = addScaled(err, h * (Real(71) / 1920), k4);
+            err = addScaled(err, h * (Real(-17253) / 339200), k5);
+            err = addScaled(err, h * (Real(22) / 525), k6);
+            err = addScaled(err, h * (Real(-1) / 40), k7);
+
+            // Mixed absolute/relative error, scaled so 1 means "exactly at tolerance"
+            using std::fabs;
+            Real errNorm = 0;
+            errNorm = std::max(errNorm, fabs(err.x) / (tol * (1 + std::max(fabs(s.x), fabs(next.x)))));
+            errNorm = std::max(errNorm, fabs(err.y) / (tol * (1 + std::max(fabs(s.y), fabs(next.y)))));
+            errNorm = std::max(errNorm, fabs(err.vx) / (tol * (1 + std::max(fabs(s.vx), fabs(next.vx)))));
+            errNorm = std::max(errNorm, fabs(err.vy) / (tol * (1 + std::max(fabs(s.vy), fabs(next.vy)))));
+
+            if (errNorm <= 1 || h <= MIN_STEP) {
+                if (next.y < 0) {
+                    Real fraction;
+                    State impact = groundCrossing(s, k1, next, k7, h, fraction);
+                    t += fraction * h;
+                    emit(stateOf<Real>(t, impact.x, impact.y, impact.vx, impact.vy));
+                    state.t = t;
+                    state.finished = true;
+                    return AdvanceStatus::Finished;
+                }
+
+                if (clipped) {
+                    t = endTime;
+                    tCarry = 0;
+                } else {
+                    Precision::add(t, tCarry, h);
+                }
+                s = next;
+                carry = nextCarry;
+                k1 = k7;
+                accepted++;
+                emit(stateOf<Real>(t, s.x, s.y, s.vx, s.vy));
+            }
+
+            Real factor = errNorm > 0 ? Real(0.9f) * std::pow(errNorm, Real(-0.2f)) : Real(5.0f);
+            h *= std::min(Real(5.0f), std::max(Real(0.2f), factor));
+            h = std::min(MAX_STEP, std::max(MIN_STEP, h));
+        }
+
+        state.s = s;
+        state.rate = k1;
+        state.carry = carry;
+        state.t = t;
+        state.tCarry = tCarry;
+        state.h = h;
+        state.reach = reach;
+        state.finished = status == AdvanceStatus::Finished;
+        return status;
+    }
+
+    // The stored derivative belongs to the old drag model; recompute it
+    template <typename Real, typename DragModel>
+    static void restart(IntegratorState<Real>& state, const ProjectileData& data, const DragModel& drag) {
+        state.rate = dragDerivative(state.s, Real(data.gravity), drag);
+    }
+
+    template <typename Precision, typename DragModel, typename Emit>
+    static float integrate(const ProjectileData& data, const DragModel& drag, uint32_t maxSteps, Emit&& emit) {
+        typedef typename Precision::Real Real;
+        IntegratorState<Real> state = start<Precision>(data, drag, emit);
+        advance<Precision>(state, data, drag, Real(INFINITY), UINT32_MAX, maxSteps, emit);
+        return (float)state.t;
+    }
+};
+
+// One launch integrated with a drag model, method and precision fixed at
+// compile time, so each combination is its own kernel whose loop only
+// branches on the state. The drag-free closed form (AnalyticalMethod) only
+// pairs with NoDrag.
+template <typename Drag, typename Method, typename Precision = SinglePrecision>
+class SimulationKernel {
+private:
+    typedef typename Precision::Real Real;
+
+    static_assert(!std::is_same<Method, AnalyticalMethod>::value || std::is_same<Drag, NoDrag>::value,
+                  "the analytical method has no drag");
+
+    ProjectileData data;
+    typename Drag::template Model<Real> drag;
+
+public:
+    explicit SimulationKernel(const ProjectileData& data) : data(data), drag(data) {}
+
+    // Emits each state to emit(const TrajectoryState&); returns the flight time
+    template <typename Emit>
+    float run(uint32_t maxSteps, Emit&& emit) const {
+        return Method::template integrate<Precision>(data, drag, maxSteps, emit);
+    }
+
+    // Stepwise form of run() for the Euler and Dormand-Prince methods, so an
+    // integration can be checkpointed and resumed (see IntegratorState)
+    template <typename Emit>
+    IntegratorState<Real> start(Emit&& emit) const {
+        return Method::template start<Precision>(data, drag, emit);
+    }
+
+    template <typename Emit>
+    AdvanceStatus advance(IntegratorState<Real>& state, Real endTime, uint32_t stepLimit,
+                          uint32_t maxSteps, Emit&& emit) const {
+        return Method::template advance<Precision>(state, data, drag, endTime, stepLimit, maxSteps, emit);
+    }
+
+    // Prepares a state reached under another kernel to continue under this one
+    void restart(IntegratorState<Real>& state) const {
+        Method::restart(state, data, drag);
+    }
+};
+
+// Runs a launch through the kernel its settings select, in the precision
+// given rather than data.precision
+template <typename Precision, typename Emit>
+float simulateLaunchWith(const ProjectileData& data, uint32_t maxSteps, Emit&& emit) {
+    if (!data.airResistance) {
+        return SimulationKernel<NoDrag, AnalyticalMethod, Precision>(data).run(maxSteps, emit);
+    }
+    if (data.integrator == Integrator::DormandPrince) {
+        if (data.fastDrag) {
+            return SimulationKernel<FastQuadraticDrag, DormandPrinceMethod, Precision>(data).run(maxSteps, emit);
+        }
+        return SimulationKernel<QuadraticDrag, DormandPrinceMethod, Precision>(data).run(maxSteps, emit);
+    }
+    if (data.fastDrag) {
+        return SimulationKernel<FastQuadraticDrag, EulerMethod, Precision>(data).run(maxSteps, emit);
+    }
+    return SimulationKernel<QuadraticDrag, EulerMethod, Precision>(data).run(maxSteps, emit);
+}
+
+// Runs a launch through the kernel its settings select. This is the only
+// runtime dispatch on the configuration, made once per launch.
+template <typename Emit>
+float simulateLaunch(const ProjectileData& data, uint32_t maxSteps, Emit&& emit) {
+    switch (data.precision) {
+    case FloatPrecision::Double:
+        return simulateLaunchWith<DoublePrecision>(data, maxSteps, emit);
+    case FloatPrecision::Compensated:
+        return simulateLaunchWith<CompensatedPrecision>(data, maxSteps, emit);
+    default:
+        return simulateLaunchWith<SinglePrecision>(data, maxSteps, emit);
+    }
+}
+
+// Stepwise run of one kernel: integrates sliceSteps steps at a time and
+// asks keepGoing() between slices. Returns false if it stopped the launch;
+// flightTime is set otherwise.
+template <typename Drag, typename Method, typename Precision, typename Emit, typename KeepGoing>
+bool runInSlices(const ProjectileData& data, uint32_t sliceSteps, Emit&& emit, KeepGoing&& keepGoing,
+                 float& flightTime) {
+    SimulationKernel<Drag, Method, Precision> kernel(data);
+    auto state = kernel.start(emit);
+    while (kernel.advance(state, INFINITY, (state.steps / sliceSteps + 1) * sliceSteps, MAX_NUMERICAL_STEPS,
+                          emit) != AdvanceStatus::Finished) {
+        if (!keepGoing()) return false;
+    }
+    flightTime = (float)state.t;
+    return true;
+}
+
+// Interruptible form of simulateLaunchWith with the same emitted states.
+// Drag-free launches are closed form and run without interruption.
+template <typename Precision, typename Emit, typename KeepGoing>
+bool simulateLaunchInSlicesWith(const ProjectileData& data, uint32_t sliceSteps, Emit&& emit,
+                                KeepGoing&& keepGoing, float& flightTime) {
+    if (!data.airResistance) {
+        flightTime = SimulationKernel<NoDrag, AnalyticalMethod, Precision>(data).run(STREAMING_MAX_STEPS, emit);
+        return true;
+    }
+    if (data.integrator == Integrator::DormandPrince) {
+        if (data.fastDrag) {
+            return runInSlices<FastQuadraticDrag, DormandPrinceMethod, Precision>(data, sliceSteps, emit,
+                                                                                  keepGoing, flightTime);
+        }
+        return runInSlices<QuadraticDrag, DormandPrinceMethod, Precision>(data, sliceSteps, emit, keepGoing,
+                                                                          flightTime);
+    }
+    if (data.fastDrag) {
+        return runInSlices<FastQuadraticDrag, EulerMethod, Precision>(data, sliceSteps, emit, keepGoing,
+                                                                      flightTime);
+    }
+    return runInSlices<QuadraticDrag, EulerMethod, Precision>(data, sliceSteps, emit, keepGoing, flightTime);
+}
+
+template <typename Emit, typename KeepGoing>
+bool simulateLaunchInSlices(const ProjectileData& data, uint32_t sliceSteps, Emit&& emit, KeepGoing&& keepGoing,
+                            float& flightTime) {
+    switch (data.precision) {
+    case FloatPrecision::Double:
+        return simulateLaunchInSlicesWith<DoublePrecision>(data, sliceSteps, emit, keepGoing, flightTime);
+    case FloatPrecision::Compensated:
+        return simulateLaunchInSlicesWith<CompensatedPrecision>(data, sliceSteps, emit, keepGoing, flightTime);
+    default:
+        return simulateLaunchInSlicesWith<SinglePrecision>(data, sliceSteps, emit, keepGoing, flightTime);
+    }
+}
+
+// Metrics of an adaptive drag run. The apex usually falls between accepted
+// steps, so it is located on the cubic Hermite interpolant of the step in
+// which vy changes sign rather than taken from the step points.
+TrajectoryMetrics dormandPrinceMetrics(const ProjectileData& data);
+
+// Metrics from the emitted states alone, as the Euler batch kernels keep
+// them, for Euler launches in a precision those kernels do not provide
+TrajectoryMetrics emittedMetrics(const ProjectileData& data);
+
+// Storage for one stored trajectory: sample positions and their times
+struct TrajectoryBuffer {
+    std::vector<Vector2D> points;
+    std::vector<float> times;
+
+    void clear() {
+        points.clear();
+        times.clear();
+    }
+
+    void reserve(size_t n) {
+        points.reserve(n);
+        times.reserve(n);
+    }
+
+    size_t capacity() const { return std::min(points.capacity(), times.capacity()); }
+};
+
+// Thread-safe free list of trajectory buffers. Simulators borrow a buffer
+// for their lifetime and return it on destruction with its capacity intact,
+// so repeated simulations stop allocating once the pool has warmed up.
+class TrajectoryBufferPool {
+private:
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TrajectoryBuffer>> freeBuffers;
+    size_t maxRetained;
+    size_t created;
+
+public:
+    explicit TrajectoryBufferPool(size_t maxRetained = 64) : maxRetained(maxRetained), created(0) {}
+
+    TrajectoryBufferPool(const TrajectoryBufferPool&) = delete;
+    TrajectoryBufferPool& operator=(const TrajectoryBufferPool&) = delete;
+
+    // Process-wide pool used by simulators that are not given one
+    static TrajectoryBufferPool& shared() {
+        static TrajectoryBufferPool pool;
+        return pool;
+    }
+
+    std::unique_ptr<TrajectoryBuffer> acquire() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!freeBuffers.empty()) {
+                std::unique_ptr<TrajectoryBuffer> buffer = std::move(freeBuffers.back());
+                freeBuffers.pop_back();
+                return buffer;
+            }
+            created++;
+        }
+        PROFILE_COUNT("alloc.trajectory_buffers", 1);
+        return std::unique_ptr<TrajectoryBuffer>(new TrajectoryBuffer());
+    }
+
+    void release(std::unique_ptr<TrajectoryBuffer> buffer) {
+        buffer->clear();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (freeBuffers.size() < maxRetained) freeBuffers.push_back(std::move(buffer));
+    }
+
+    // Number of buffers this pool has had to allocate so far
+    size_t buffersCreated() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return created;
+    }
+};
+
+// Upper bound on the number of stored points for a launch, from the
+// drag-free flight time (drag only shortens the flight) plus the impact
+// point. Used to reserve trajectory capacity before integrating.
+size_t estimatedPointCount(const ProjectileData& data);
+
+// Buffered text output for large tables. Numbers are formatted with
+// std::to_chars (locale-independent, no stream state) into one reusable
+// buffer that is handed to the stream in large writes. Output matches the
+// equivalent std::setw / std::fixed / std::setprecision stream formatting.
+class TextWriter {
+private:
+    std::ostream& out;
+    std::vector<char> buffer;
+    size_t used;
+
+    char* reserve(size_t size) {
+        if (used + size > buffer.size()) flush();
+        if (size > buffer.size()) buffer.resize(size);
+        return buffer.data() + used;
+    }
+
+    TextWriter& padded(const char* text, size_t length, int width) {
+        size_t padding = width > (int)length ? width - length : 0;
+        char* dest = reserve(padding + length);
+        std::memset(dest, ' ', padding);
+        std::memcpy(dest + padding, text, length);
+        used += padding + length;
+        return *this;
+    }
+
+    static size_t formatFixed(char* dest, size_t size, double value, int precision) {
+#if defined(__cpp_lib_to_chars)
+        return std::to_chars(dest, dest + size, value, std::chars_format::fixed, precision).ptr - dest;
+#else
+        return std::snprintf(dest, size, "%.*f", precision, value);
+#endif
+    }
+
+    static size_t formatGeneral(char* dest, size_t size, double value) {
+#if defined(__cpp_lib_to_chars)
+        return std::to_chars(dest, dest + size, value, std::chars_format::general, 6).ptr - dest;
+#else
+        return std::snprintf(dest, size, "%g", value);
+#endif
+    }
+
+public:
+    explicit TextWriter(std::ostream& out, size_t capacity = 1 << 16)
+        : out(out), buffer(capacity), used(0) {}
+
+    ~TextWriter() { flush(); }
+
+    TextWriter(const TextWriter&) = delete;
+    TextWriter& operator=(const TextWriter&) = delete;
+
+    TextWriter& put(char c) {
+        *reserve(1) = c;
+        used++;
+        return *this;
+    }
+
+    // Right-aligned in width columns, like std::setw
+    TextWriter& text(const std::string& value, int width = 0) {
+        return padded(value.data(), value.size(), width);
+    }
+
+    TextWriter& text(const char* value, int width = 0) {
+        return padded(value, std::strlen(value), width);
+    }
+
+    TextWriter& integer(long long value, int width = 0) {
+        char digits[24];
+        return padded(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr - digits, width);
+    }
+
+    // std::fixed << std::setprecision(precision) << std::setw(width)
+    TextWriter& fixed(float value, int precision, int width = 0) {
+        char digits[384];
+        return padded(digits, formatFixed(digits, sizeof(digits), value, precision), width);
+    }
+
+    // Default stream formatting (six significant digits)
+    TextWriter& general(float value) {
+        char digits[32];
+        return padded(digits, formatGeneral(digits, sizeof(digits), value), 0);
+    }
+
+    void flush() {
+        PROFILE_COUNT("output.bytes", used);
+        if (used) out.write(buffer.data(), used);
+        used = 0;
+    }
+};
+
+// n copies of the box-drawing line character (three bytes in UTF-8, so it
+// cannot be repeated with std::string(n, c))
+std::string horizontalRule(size_t n);
+
+// Character-cell plot of trajectories over a ground line, for terminals.
+// World coordinates map to cells by the canvas extent, so include() every
+// trajectory before plotting any of them. Consecutive points are joined
+// with Bresenham lines and later marks overwrite earlier ones, so several
+// trajectories can be overlaid with different marks. render() composes the
+// framed plot as UTF-8 and writes it with a single call.
+class TrajectoryCanvas {
+private:
+    int width, height; // cells inside the frame; the bottom row is the ground
+    float maxX, maxY;
+    std::vector<char32_t> cells;
+    std::vector<std::pair<char32_t, std::string>> legend;
+    int penColumn, penRow;
+
+    void set(int column, int row, char32_t glyph) {
+        if (column >= 0 && column < width && row >= 0 && row < height - 1) {
+            cells[(size_t)row * width + column] = glyph;
+        }
+    }
+
+    static void putUtf8(TextWriter& out, char32_t c) {
+        if (c < 0x80) {
+            out.put((char)c);
+        } else if (c < 0x800) {
+            out.put((char)(0xC0 | (c >> 6))).put((char)(0x80 | (c & 0x3F)));
+        } else if (c < 0x10000) {
+            out.put((char)(0xE0 | (c >> 12))).put((char)(0x80 | ((c >> 6) & 0x3F)))
+               .put((char)(0x80 | (c & 0x3F)));
+        } else {
+            out.put((char)(0xF0 | (c >> 18))).put((char)(0x80 | ((c >> 12) & 0x3F)))
+               .put((char)(0x80 | ((c >> 6) & 0x3F))).put((char)(0x80 | (c & 0x3F)));
+        }
+    }
+
+public:
+    static constexpr char32_t GROUND = U'─';
+
+    explicit TrajectoryCanvas(int width = 80, int height = 25)
+        : width(std::max(width, 2)), height(std::max(height, 3)), maxX(0), maxY(0),
+          cells((size_t)this->width * this->height, U' '), penColumn(0), penRow(0) {
+        std::fill(cells.end() - this->width, cells.end(), GROUND);
+    }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    float extentX() const { return maxX; }
+    float extentY() const { return maxY; }
+
+    // Grows the extent to contain (x, y)
+    void include(float x, float y) {
+        maxX = std::max(maxX, x);
+        maxY = std::max(maxY, y);
+    }
+
+    int column(float x) const {
+        return maxX > 0 ? (int)std::lround(x / maxX * (width - 1)) : 0;
+    }
+
+    // Rows count down from the top; y = 0 is the row just above the ground
+    int row(float y) const {
+        return (height - 2) - (maxY > 0 ? (int)std::lround(y / maxY * (height - 2)) : 0);
+    }
+
+    void moveTo(float x, float y, char32_t mark) {
+        penColumn = column(x);
+        penRow = row(y);
+        set(penColumn, penRow, mark);
+    }
+
+    // Bresenham line from the pen to (x, y)
+    void lineTo(float x, float y, char32_t mark) {
+        int c1 = column(x), r1 = row(y);
+        int dc = std::abs(c1 - penColumn), dr = -std::abs(r1 - penRow);
+        int sc = penColumn < c1 ? 1 : -1, sr = penRow < r1 ? 1 : -1;
+        int error = dc + dr;
+        for (int c = penColumn, r = penRow; ; ) {
+            set(c, r, mark);
+            if (c == c1 && r == r1) break;
+            int doubled = 2 * error;
+            if (doubled >= dr) { error += dr; c += sc; }
+            if (doubled <= dc) { error += dc; r += sr; }
+        }
+        penColumn = c1;
+        penRow = r1;
+    }
+
+    void plot(const std::vector<Vector2D>& points, char32_t mark) {
+        for (size_t i = 0; i < points.size(); i++) {
+            if (i == 0) moveTo(points[i].x, points[i].y, mark);
+            else lineTo(points[i].x, points[i].y, mark);
+        }
+    }
+
+    void addLegend(char32_t mark, const std::string& label) {
+        legend.emplace_back(mark, label);
+    }
+
+    // Upper bound on the bytes render() writes, excluding the legend
+    size_t frameBytes(size_t indent) const {
+        return (size_t)(height + 2) * (indent + 4 * (width + 2) + 1);
+    }
+
+    // The framed plot, each row prefixed by indent, then the legend line
+    void render(TextWriter& out, const std::string& indent = "  ") const {
+        out.text(indent).text("┌").text(horizontalRule(width)).text("┐\n");
+        for (int r = 0; r < height; r++) {
+            out.text(indent).text("│");
+            for (int c = 0; c < width; c++) putUtf8(out, cells[(size_t)r * width + c]);
+            out.text("│\n");
+        }
+        out.text(indent).text("└").text(horizontalRule(width)).text("┘\n");
+
+        if (legend.empty()) return;
+        out.text(indent);
+        for (size_t i = 0; i < legend.size(); i++) {
+            if (i > 0) out.text(", ");
+            putUtf8(out, legend[i].first);
+            out.text(" = ").text(legend[i].second);
+        }
+        out.put('\n');
+    }
+};
+
+// Draws each streamed trajectory on a canvas as it is produced, so no
+// trajectory is stored. The canvas extent must already cover the launches.
+class CanvasSink : public TrajectorySink {
+private:
+    TrajectoryCanvas& canvas;
+    char32_t mark;
+    bool first;
+
+public:
+    CanvasSink(TrajectoryCanvas& canvas, char32_t mark) : canvas(canvas), mark(mark), first(true) {}
+
+    void setMark(char32_t newMark) { mark = newMark; }
+
+    void begin(const ProjectileData&) override { first = true; }
+
+    void push(const TrajectoryState& s) override {
+        if (first) canvas.moveTo(s.x, s.y, mark);
+        else canvas.lineTo(s.x, s.y, mark);
+        first = false;
+    }
+};
+
+// Running reducer: keeps max height, range and flight time in constant space
+class SummarySink : public TrajectorySink {
+public:
+    TrajectoryMetrics metrics;
+    size_t states;
+
+    SummarySink() : states(0) {}
+
+    void begin(const ProjectileData&) override {
+        metrics = TrajectoryMetrics();
+        states = 0;
+    }
+
+    void push(const TrajectoryState& state) override {
+        if (state.y > metrics.maxHeight) metrics.maxHeight = state.y;
+        metrics.range = state.x;
+        metrics.flightTime = state.t;
+        states++;
+    }
+};
+
+// Forwards every n-th state, plus the final one, to another sink
+class DecimatingSink : public TrajectorySink {
+private:
+    TrajectorySink& next;
+    size_t every;
+    size_t index;
+    bool pending;
+    TrajectoryState last;
+
+public:
+    DecimatingSink(TrajectorySink& next, size_t every)
+        : next(next), every(every == 0 ? 1 : every), index(0), pending(false), last() {}
+
+    void begin(const ProjectileData& data) override {
+        index = 0;
+        pending = false;
+        next.begin(data);
+    }
+
+    void push(const TrajectoryState& state) override {
+        pending = index % every != 0;
+        if (!pending) next.push(state);
+        last = state;
+        index++;
+    }
+
+    void end() override {
+        if (pending) next.push(last);
+        next.end();
+    }
+};
+
+// Forwards as few states as it can while every state it drops stays
+// within tolerance meters of the path through the forwarded ones. States
+// are decided online, in O(1) each, by cone intersection: each dropped state
+// narrows the cone of directions from the last kept state that pass within
+// tolerance of it, and the previous state is kept once the next one falls
+// outside. The first and last states and the apex are always kept, so the
+// maximum height, range and flight time of the forwarded states are exact.
+class SimplifyingSink : public TrajectorySink {
+private:
+    TrajectorySink& next;
+    float tolerance;
+    TrajectoryState anchor, last; // last kept and last received state
+    bool started, pending, rising; // pending: last is not forwarded yet
+    // Cone of allowed directions from anchor, as unit vectors bounding it
+    // clockwise (right) and counter-clockwise (left)
+    bool bounded, empty;
+    float rightX, rightY, leftX, leftY;
+    float reach; // farthest dropped state from anchor
+    uint64_t received, forwarded;
+
+    static float cross(float ax, float ay, float bx, float by) { return ax * by - ay * bx; }
+
+    void keep(const TrajectoryState& state) {
+        next.push(state);
+        forwarded++;
+        anchor = state;
+        bounded = empty = false;
+        reach = 0;
+    }
+
+    void constrain(const TrajectoryState& s) {
+        float dx = s.x - anchor.x, dy = s.y - anchor.y;
+        float d = std::sqrt(dx * dx + dy * dy);
+        reach = std::max(reach, d);
+        if (d <= tolerance) return;
+
+        float sinA = tolerance / d, cosA = std::sqrt(1 - sinA * sinA);
+        float ux = dx / d, uy = dy / d;
+        float rx = ux * cosA + uy * sinA, ry = uy * cosA - ux * sinA;
+        float lx = ux * cosA - uy * sinA, ly = uy * cosA + ux * sinA;
+        if (!bounded) {
+            rightX = rx, rightY = ry, leftX = lx, leftY = ly;
+            bounded = true;
+            return;
+        }
+        if (cross(rightX, rightY, rx, ry) > 0) rightX = rx, rightY = ry;
+        if (cross(lx, ly, leftX, leftY) > 0) leftX = lx, leftY = ly;
+        if (cross(rightX, rightY, leftX, leftY) < 0) empty = true;
+    }
+
+    // Whether the segment from anchor to s passes within tolerance of every
+    // dropped state; s must also be at least as far as each of them, so
+    // they project onto the segment rather than past its end
+    bool covers(const TrajectoryState& s) const {
+        if (empty) return false;
+        float dx = s.x - anchor.x, dy = s.y - anchor.y;
+        if (dx * dx + dy * dy < reach * reach) return false;
+        return !bounded || (cross(rightX, rightY, dx, dy) >= 0 && cross(dx, dy, leftX, leftY) >= 0);
+    }
+
+public:
+    SimplifyingSink(TrajectorySink& next, float tolerance)
+        : next(next), tolerance(std::max(tolerance, 0.0f)), anchor(), last(), started(false),
+          pending(false), rising(false), bounded(false), empty(false), rightX(0), rightY(0),
+          leftX(0), leftY(0), reach(0), received(0), forwarded(0) {}
+
+    void begin(const ProjectileData& data) override {
+        started = pending = rising = false;
+        next.begin(data);
+    }
+
+    void push(const TrajectoryState& state) override {
+        received++;
+        if (!started) {
+            started = true;
+            keep(state);
+            last = state;
+            return;
+        }
+        if (pending) {
+            bool apex = rising && state.y <= last.y;
+            if (apex) {
+                keep(last);
+            } else {
+                constrain(last);
+                if (!covers(state)) keep(last);
+            }
+        }
+        rising = state.y > last.y;
+        last = state;
+        pending = true;
+    }
+
+    void end() override {
+        if (pending) keep(last);
+        pending = false;
+        next.end();
+    }
+
+    // Totals over every launch streamed through the sink
+    uint64_t statesReceived() const { return received; }
+    uint64_t statesForwarded() const { return forwarded; }
+};
+
+// Indices of the points the Ramer-Douglas-Peucker algorithm keeps so that
+// every point is within tolerance of the polyline through the kept ones,
+// in order and always including the first and last
+std::vector<size_t> simplifyPath(const std::vector<Vector2D>& points, float tolerance);
+
+// Writes each state as a CSV row (t,x,y,vx,vy)
+class CsvTrajectoryWriter : public TrajectorySink {
+private:
+    TextWriter out;
+
+public:
+    explicit CsvTrajectoryWriter(std::ostream& out) : out(out) {}
+
+    void begin(const ProjectileData&) override {
+        out.text("t,x,y,vx,vy\n");
+    }
+
+    void push(const TrajectoryState& s) override {
+        out.general(s.t).put(',').general(s.x).put(',').general(s.y).put(',')
+           .general(s.vx).put(',').general(s.vy).put('\n');
+    }
+
+    void end() override {
+        out.flush();
+    }
+};
+
+// Feeds the same states to two sinks
+class TeeSink : public TrajectorySink {
+private:
+    TrajectorySink& first;
+    TrajectorySink& second;
+
+public:
+    TeeSink(TrajectorySink& first, TrajectorySink& second) : first(first), second(second) {}
+
+    void begin(const ProjectileData& data) override {
+        first.begin(data);
+        second.begin(data);
+    }
+
+    void push(const TrajectoryState& state) override {
+        first.push(state);
+        second.push(state);
+    }
+
+    void end() override {
+        first.end();
+        second.end();
+    }
+};
+
+// Compact binary trajectory file. Layout (little-endian, 8-byte aligned):
+//
+//   TrajectoryFileHeader
+//   per launch: t, x and y columns, each encoded per the header's encoding
+//   TrajectoryFileRecord[launchCount] at header.directoryOffset
+//
+// Raw columns are plain float32 arrays and can be used in place from a
+// memory mapping. Quantized16 stores each column as uint16 steps of
+// columnScale above columnMin (error at most columnScale / 2), and
+// DeltaQuantized stores second differences of those steps as zigzag varints,
+// which are near zero for smooth trajectories and mostly take one byte.
+enum class TrajectoryEncoding : uint32_t {
+    Raw = 0,
+    Quantized16 = 1,
+    DeltaQuantized = 2
+};
+
+enum class TrajectoryColumn : int {
+    Time = 0,
+    X = 1,
+    Y = 2
+};
+
+const int TRAJECTORY_COLUMNS = 3;
+const char TRAJECTORY_FILE_MAGIC[4] = {'P', 'M', 'T', 'R'};
+const uint32_t TRAJECTORY_FILE_VERSION = 2;
+const size_t TRAJECTORY_FILE_V1_HEADER_SIZE = 32; // version 1 has no fingerprint
+
+struct TrajectoryFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t encoding;
+    uint32_t columnCount;
+    uint64_t launchCount;
+    uint64_t directoryOffset;
+    uint64_t fingerprint; // of the sweep a shard file belongs to; 0 otherwise
+};
+
+// Launch parameters, metrics and the location of its columns
+struct TrajectoryFileRecord {
+    float initialVelocity, angle, gravity, dragCoefficient, mass, tolerance;
+    uint8_t airResistance, integrator, fastDrag, precision;
+    float maxHeight, range, flightTime;
+    uint32_t pointCount;
+    float columnMin[TRAJECTORY_COLUMNS];
+    float columnScale[TRAJECTORY_COLUMNS];
+    uint64_t columnOffset[TRAJECTORY_COLUMNS];
+    uint64_t columnBytes[TRAJECTORY_COLUMNS];
+
+    ProjectileData launch() const {
+        ProjectileData data;
+        data.initialVelocity = initialVelocity;
+        data.angle = angle;
+        data.gravity = gravity;
+        data.airResistance = airResistance != 0;
+        data.dragCoefficient = dragCoefficient;
+        data.mass = mass;
+        data.integrator = (Integrator)integrator;
+        data.tolerance = tolerance;
+        data.fastDrag = fastDrag != 0;
+        data.precision = (FloatPrecision)precision;
+        return data;
+    }
+};
+
+static_assert(sizeof(TrajectoryFileHeader) == 40, "unexpected header padding");
+static_assert(sizeof(TrajectoryFileRecord) % 8 == 0, "records must keep 8-byte alignment");
+
+// Writes every launch streamed into it to a trajectory file. Each launch is
+// buffered only between begin() and end(); close() appends the directory.
+class TrajectoryFileWriter : public TrajectorySink {
+private:
+    std::unique_ptr<std::ofstream> out;
+    TrajectoryEncoding encoding;
+    uint64_t fingerprint;
+    uint64_t offset;
+    std::vector<TrajectoryFileRecord> records;
+    TrajectoryFileRecord current;
+    std::vector<float> columns[TRAJECTORY_COLUMNS];
+    std::vector<unsigned char> encoded;
+
+    void writeBytes(const void* data, size_t size);
+    void pad();
+    static void appendVarint(std::vector<unsigned char>& bytes, uint32_t value);
+    void encodeColumn(int c);
+
+public:
+    TrajectoryFileWriter();
+    ~TrajectoryFileWriter();
+
+    // fingerprint is stored in the header (see sweepFingerprint())
+    bool open(const std::string& path, TrajectoryEncoding encoding, uint64_t fingerprint = 0);
+
+    void begin(const ProjectileData& data) override {
+        current = TrajectoryFileRecord();
+        current.initialVelocity = data.initialVelocity;
+        current.angle = data.angle;
+        current.gravity = data.gravity;
+        current.dragCoefficient = data.dragCoefficient;
+        current.mass = data.mass;
+        current.tolerance = data.tolerance;
+        current.airResistance = data.airResistance ? 1 : 0;
+        current.integrator = (uint8_t)data.integrator;
+        current.fastDrag = data.fastDrag ? 1 : 0;
+        current.precision = (uint8_t)data.precision;
+        for (auto& column : columns) column.clear();
+    }
+
+    void push(const TrajectoryState& state) override {
+        columns[(int)TrajectoryColumn::Time].push_back(state.t);
+        columns[(int)TrajectoryColumn::X].push_back(state.x);
+        columns[(int)TrajectoryColumn::Y].push_back(state.y);
+        if (state.y > current.maxHeight) current.maxHeight = state.y;
+        current.range = state.x;
+        current.flightTime = state.t;
+    }
+
+    void end() override;
+
+    // Adds a launch with its metrics and no trajectory (a record with no
+    // points), for files that keep only results
+    void add(const ProjectileData& data, const TrajectoryMetrics& metrics) {
+        begin(data);
+        current.maxHeight = metrics.maxHeight;
+        current.range = metrics.range;
+        current.flightTime = metrics.flightTime;
+        end();
+    }
+
+    // Writes the directory and final header; false if any write failed
+    bool close();
+};
+
+// Read-only view of a trajectory file. The file is memory-mapped where the
+// platform allows it (read into memory otherwise), and raw columns are
+// returned without copying. Opening checks every directory record, so it
+// is O(n) in the number of launches, but no column data is read.
+class TrajectoryFileReader {
+private:
+    const unsigned char* base;
+    size_t length;
+    std::vector<unsigned char> contents;
+#if !defined(_WIN32)
+    void* mapping;
+#endif
+
+    const TrajectoryFileHeader& header() const { return *(const TrajectoryFileHeader*)base; }
+
+    bool validate(std::string& error) const;
+
+public:
+    TrajectoryFileReader() : base(nullptr), length(0) {
+#if !defined(_WIN32)
+        mapping = nullptr;
+#endif
+    }
+
+    ~TrajectoryFileReader() { close(); }
+
+    TrajectoryFileReader(const TrajectoryFileReader&) = delete;
+    TrajectoryFileReader& operator=(const TrajectoryFileReader&) = delete;
+
+    bool open(const std::string& path, std::string& error);
+
+    void close();
+
+    size_t launchCount() const { return base ? (size_t)header().launchCount : 0; }
+
+    TrajectoryEncoding encoding() const { return (TrajectoryEncoding)header().encoding; }
+
+    // 0 for files that are not shards and for version 1 files
+    uint64_t fingerprint() const { return base && header().version >= 2 ? header().fingerprint : 0; }
+
+    const TrajectoryFileRecord& record(size_t launch) const {
+        const unsigned char* directory = base + header().directoryOffset;
+        return ((const TrajectoryFileRecord*)directory)[launch];
+    }
+
+    // Zero-copy column of a Raw file; nullptr for compressed encodings
+    const float* rawColumn(size_t launch, TrajectoryColumn column) const {
+        if (encoding() != TrajectoryEncoding::Raw) return nullptr;
+        return (const float*)(base + record(launch).columnOffset[(int)column]);
+    }
+
+    // Decodes a column of any encoding into out
+    void decodeColumn(size_t launch, TrajectoryColumn column, std::vector<float>& out) const;
+};
+
+// Quantization steps for cache keys. A field whose step is 0 must match
+// bit for bit; otherwise values are rounded to the nearest multiple of the
+// step, so launches closer than half a step share one cached result.
+struct CacheQuantization {
+    float initialVelocity = 0;
+    float angle = 0;
+    float gravity = 0;
+    float dragCoefficient = 0;
+    float mass = 0;
+};
+
+// Launch identity used by LaunchCache. Fields that cannot affect the result
+// (drag parameters without air resistance, tolerance for Euler) are zeroed
+// so equivalent launches share an entry. The precision is kept for every
+// launch, since the closed form is also evaluated in double when asked.
+struct LaunchKey {
+    int64_t initialVelocity, angle, gravity, dragCoefficient, mass, tolerance;
+    unsigned char airResistance, integrator, fastDrag, precision;
+
+    LaunchKey(const ProjectileData& data, const CacheQuantization& q)
+        : initialVelocity(quantize(data.initialVelocity, q.initialVelocity)),
+          angle(quantize(data.angle, q.angle)),
+          gravity(quantize(data.gravity, q.gravity)),
+          dragCoefficient(0), mass(0), tolerance(0),
+          airResistance(data.airResistance ? 1 : 0), integrator(0), fastDrag(0),
+          precision((unsigned char)data.precision) {
+        if (data.airResistance) {
+            dragCoefficient = quantize(data.dragCoefficient, q.dragCoefficient);
+            mass = quantize(data.mass, q.mass);
+            integrator = (unsigned char)data.integrator;
+            fastDrag = data.fastDrag ? 1 : 0;
+            if (data.integrator == Integrator::DormandPrince) tolerance = quantize(data.tolerance, 0);
+        }
+    }
+
+    static int64_t quantize(float value, float step) {
+        if (step > 0) return std::llround(value / step);
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    bool operator==(const LaunchKey& o) const {
+        return initialVelocity == o.initialVelocity && angle == o.angle && gravity == o.gravity &&
+               dragCoefficient == o.dragCoefficient && mass == o.mass && tolerance == o.tolerance &&
+               airResistance == o.airResistance && integrator == o.integrator &&
+               fastDrag == o.fastDrag && precision == o.precision;
+    }
+
+    uint64_t hash() const {
+        uint64_t h = 0x9e3779b97f4a7c15ull;
+        auto mix = [&](uint64_t v) {
+            h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+            h *= 0xff51afd7ed558ccdull;
+        };
+        mix(initialVelocity);
+        mix(angle);
+        mix(gravity);
+        mix(dragCoefficient);
+        mix(mass);
+        mix(tolerance);
+        mix(airResistance | integrator << 8 | fastDrag << 16 | precision << 24);
+        return h ^ (h >> 33);
+    }
+};
+
+struct LaunchKeyHash {
+    size_t operator()(const LaunchKey& key) const { return (size_t)key.hash(); }
+};
+
+// Bounded least-recently-used cache of per-launch results, safe to share
+// between sweep workers. Entries are spread over independently locked
+// shards so concurrent lookups rarely contend.
+template <typename Value>
+class LaunchCache {
+private:
+    typedef std::list<std::pair<LaunchKey, Value>> Entries;
+
+    struct Shard {
+        std::mutex mutex;
+        Entries entries; // most recently used first
+        std::unordered_map<LaunchKey, typename Entries::iterator, LaunchKeyHash> index;
+    };
+
+    CacheQuantization quantization;
+    size_t shardCapacity;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::atomic<uint64_t> hitCount;
+    std::atomic<uint64_t> missCount;
+
+    Shard& shardFor(uint64_t hash) {
+        return *shards[(hash >> 48) % shards.size()];
+    }
+
+public:
+    explicit LaunchCache(size_t capacity, const CacheQuantization& quantization = CacheQuantization(),
+                         size_t shardCount = 16)
+        : quantization(quantization), hitCount(0), missCount(0) {
+        shardCount = std::max<size_t>(1, std::min(shardCount, capacity));
+        shardCapacity = std::max<size_t>(1, capacity / shardCount);
+        for (size_t i = 0; i < shardCount; i++) shards.emplace_back(new Shard());
+    }
+
+    LaunchKey keyFor(const ProjectileData& data) const { return LaunchKey(data, quantization); }
+
+    bool lookup(const ProjectileData& data, Value& value) { return lookup(keyFor(data), value); }
+
+    bool lookup(const LaunchKey& key, Value& value) {
+        Shard& shard = shardFor(key.hash());
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        auto found = shard.index.find(key);
+        if (found == shard.index.end()) {
+            missCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+        value = found->second->second;
+        hitCount.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void insert(const ProjectileData& data, const Value& value) { insert(keyFor(data), value); }
+
+    void insert(const LaunchKey& key, const Value& value) {
+        Shard& shard = shardFor(key.hash());
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        auto found = shard.index.find(key);
+        if (found != shard.index.end()) {
+            found->second->second = value;
+            shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+            return;
+        }
+        if (shard.entries.size() >= shardCapacity) {
+            shard.index.erase(shard.entries.back().first);
+            shard.entries.pop_back();
+        }
+        shard.entries.emplace_front(key, value);
+        shard.index.emplace(key, shard.entries.begin());
+    }
+
+    void clear() {
+        for (auto& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            shard->entries.clear();
+            shard->index.clear();
+        }
+        hitCount = 0;
+        missCount = 0;
+    }
+
+    size_t size() {
+        size_t total = 0;
+        for (auto& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            total += shard->entries.size();
+        }
+        return total;
+    }
+
+    size_t capacity() const { return shardCapacity * shards.size(); }
+    uint64_t hits() const { return hitCount.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return missCount.load(std::memory_order_relaxed); }
+};
+
+// A stored trajectory as kept by TrajectoryCache
+struct CachedTrajectory {
+    TrajectoryBuffer buffer;
+    TrajectoryStats stats;
+};
+
+typedef LaunchCache<TrajectoryMetrics> MetricsCache;
+typedef LaunchCache<std::shared_ptr<const CachedTrajectory>> TrajectoryCache;
+
+// A change to the drag parameters part-way through a flight: steps from
+// time onward use the new drag coefficient and mass
+struct ParameterChange {
+    float time;
+    float dragCoefficient;
+    float mass;
+};
+
+// Integrator state saved while a drag trajectory is calculated, with the
+// number of trajectory points stored up to it and their statistics
+struct TrajectoryCheckpoint {
+    IntegratorState<float> state;
+    size_t points;
+    TrajectoryStats stats;
+};
+
+class ProjectileSimulator {
+private:
+    ProjectileData data;
+    TrajectoryBufferPool& pool;
+    std::unique_ptr<TrajectoryBuffer> buffer;
+    std::vector<Vector2D>& trajectoryPoints;
+    std::vector<float>& trajectoryTimes;
+    TrajectoryStats stats;
+    std::vector<TrajectoryCheckpoint> checkpoints;
+    bool hasChange;
+    ParameterChange change;
+    
+public:
+    ProjectileSimulator(const ProjectileData& data,
+                        TrajectoryBufferPool& pool = TrajectoryBufferPool::shared())
+        : data(data), pool(pool), buffer(pool.acquire()),
+          trajectoryPoints(buffer->points), trajectoryTimes(buffer->times),
+          hasChange(false), change() {}
+    
+    ~ProjectileSimulator() {
+        pool.release(std::move(buffer));
+    }
+    
+    ProjectileSimulator(const ProjectileSimulator&) = delete;
+    ProjectileSimulator& operator=(const ProjectileSimulator&) = delete;
+    
+private:
+    // Integrator callback that appends each state to the stored trajectory
+    // and its statistics
+    auto storeState() {
+        return [this](const TrajectoryState& state) {
+            trajectoryPoints.push_back(Vector2D(state.x, state.y));
+            trajectoryTimes.push_back(state.t);
+            stats.add(state);
+        };
+    }
+    
+    // Integrates a drag launch from resume, or from launch when it is null,
+    // storing the states. A checkpoint is recorded every
+    // Method::CHECKPOINT_STEPS steps, and the changed parameters take over
+    // at the change time. Checkpoints hold float states, so none are kept
+    // in double precision and resume must then be null.
+    template <typename Drag, typename Method, typename Precision>
+    void integrateCheckpointed(const TrajectoryCheckpoint* resume) {
+        typedef typename Precision::Real Real;
+        const bool checkpointed = std::is_same<Real, float>::value;
+        
+        ProjectileData tail = data;
+        if (hasChange) {
+            tail.dragCoefficient = change.dragCoefficient;
+            tail.mass = change.mass;
+        }
+        SimulationKernel<Drag, Method, Precision> before(data), after(tail);
+        Real changeTime = hasChange ? change.time : INFINITY;
+        
+        // Every checkpoint used for resuming precedes the change
+        IntegratorState<Real> state;
+        if constexpr (checkpointed) {
+            if (resume) {
+                state = resume->state;
+                trajectoryPoints.resize(resume->points);
+                trajectoryTimes.resize(resume->points);
+                stats = resume->stats;
+            } else {
+                checkpoints.clear();
+                state = before.start(storeState());
+                checkpoints.push_back({state, trajectoryPoints.size(), stats});
+            }
+        } else {
+            checkpoints.clear();
+            state = before.start(storeState());
+        }
+        
+        bool changed = false;
+        for (;;) {
+            uint32_t nextCheckpoint = checkpointed
+                ? (state.steps / Method::CHECKPOINT_STEPS + 1) * Method::CHECKPOINT_STEPS
+                : UINT32_MAX;
+            AdvanceStatus status = changed
+                ? after.advance(state, INFINITY, nextCheckpoint, MAX_NUMERICAL_STEPS, storeState())
+                : before.advance(state, changeTime, nextCheckpoint, MAX_NUMERICAL_STEPS, storeState());
+            if (status == AdvanceStatus::Finished) break;
+            if (status == AdvanceStatus::Paused) {
+                if constexpr (checkpointed) checkpoints.push_back({state, trajectoryPoints.size(), stats});
+            } else {
+                after.restart(state);
+                changed = true;
+            }
+        }
+        stats.flightTime = state.t;
+        PROFILE_COUNT("integrate.steps", state.steps - (resume ? resume->state.steps : 0));
+    }
+    
+    template <typename Precision>
+    void integrateDragWith(const TrajectoryCheckpoint* resume) {
+        if (data.integrator == Integrator::DormandPrince) {
+            if (data.fastDrag) {
+                integrateCheckpointed<FastQuadraticDrag, DormandPrinceMethod, Precision>(resume);
+            } else {
+                integrateCheckpointed<QuadraticDrag, DormandPrinceMethod, Precision>(resume);
+            }
+        } else if (data.fastDrag) {
+            integrateCheckpointed<FastQuadraticDrag, EulerMethod, Precision>(resume);
+        } else {
+            integrateCheckpointed<QuadraticDrag, EulerMethod, Precision>(resume);
+        }
+    }
+    
+    void integrateDrag(const TrajectoryCheckpoint* resume) {
+        switch (data.precision) {
+        case FloatPrecision::Double:
+            integrateDragWith<DoublePrecision>(nullptr);
+            break;
+        case FloatPrecision::Compensated:
+            integrateDragWith<CompensatedPrecision>(resume);
+            break;
+        default:
+            integrateDragWith<SinglePrecision>(resume);
+        }
+    }
+    
+public:
+    
+    // Calculates and stores the trajectory, including any change set by
+    // resimulateFrom()
+    void calculateTrajectory() {
+        PROFILE_SCOPE("simulator.calculate_trajectory");
+        buffer->clear();
+        buffer->reserve(estimatedPointCount(data));
+        checkpoints.clear();
+        stats = TrajectoryStats();
+        
+        if (!data.airResistance) {
+            calculateAnalytical();
+        } else if (data.integrator == Integrator::DormandPrince) {
+            calculateAdaptive();
+        } else {
+            calculateNumerical();
+        }
+        PROFILE_COUNT("simulator.points_stored", trajectoryPoints.size());
+        PROFILE_COUNT("simulator.checkpoints", checkpoints.size());
+    }
+    
+    // Copies the trajectory of an equivalent earlier launch from cache when
+    // there is one; otherwise integrates and adds the result to the cache.
+    // Launches with a parameter change bypass the cache.
+    void calculateTrajectory(TrajectoryCache& cache) {
+        if (hasChange) {
+            calculateTrajectory();
+            return;
+        }
+        std::shared_ptr<const CachedTrajectory> cached;
+        if (cache.lookup(data, cached)) {
+            trajectoryPoints = cached->buffer.points;
+            trajectoryTimes = cached->buffer.times;
+            stats = cached->stats;
+            checkpoints.clear();
+            return;
+        }
+        
+        calculateTrajectory();
+        cache.insert(data, std::make_shared<const CachedTrajectory>(CachedTrajectory{*buffer, stats}));
+    }
+    
+    void calculateAnalytical() {
+        if (data.precision == FloatPrecision::Double) {
+            stats.flightTime = SimulationKernel<NoDrag, AnalyticalMethod, DoublePrecision>(data)
+                .run(UINT32_MAX, storeState());
+        } else {
+            stats.flightTime = SimulationKernel<NoDrag, AnalyticalMethod>(data).run(UINT32_MAX, storeState());
+        }
+    }
+    
+    void calculateNumerical() {
+        integrateDrag(nullptr);
+    }
+    
+    void calculateAdaptive() {
+        integrateDrag(nullptr);
+    }
+    
+    // Applies change (replacing any earlier one) and brings the stored
+    // trajectory up to date. A drag trajectory resumes from the last
+    // checkpoint whose steps, including rejected adaptive trials, all ended
+    // before both this change and the previous one, so it matches a fresh
+    // run with the change exactly and only the tail is integrated again;
+    // otherwise it is calculated from launch. simulate() and
+    // calculateMetrics() do not see the change.
+    void resimulateFrom(const ParameterChange& newChange) {
+        PROFILE_SCOPE("simulator.resimulate");
+        float validUntil = std::min(newChange.time, hasChange ? change.time : INFINITY);
+        change = newChange;
+        hasChange = true;
+        
+        while (!checkpoints.empty() &&
+               !(std::max(checkpoints.back().state.t, checkpoints.back().state.reach) < validUntil)) {
+            checkpoints.pop_back();
+        }
+        if (!data.airResistance || checkpoints.empty()) {
+            calculateTrajectory();
+            return;
+        }
+        
+        TrajectoryCheckpoint resume = checkpoints.back();
+        integrateDrag(&resume);
+    }
+    
+    // Keeps only the stored points simplifyPath() selects, returning how
+    // many were removed. The statistics are those of the full trajectory.
+    // Checkpoints index the full trajectory, so they are dropped and a
+    // later resimulateFrom() recalculates from launch.
+    size_t simplifyTrajectory(float tolerance) {
+        std::vector<size_t> kept = simplifyPath(trajectoryPoints, tolerance);
+        for (size_t i = 0; i < kept.size(); i++) {
+            trajectoryPoints[i] = trajectoryPoints[kept[i]];
+            trajectoryTimes[i] = trajectoryTimes[kept[i]];
+        }
+        size_t removed = trajectoryPoints.size() - kept.size();
+        trajectoryPoints.resize(kept.size());
+        trajectoryTimes.resize(kept.size());
+        checkpoints.clear();
+        return removed;
+    }
+    
+    // Streams every state of the launch to sink instead of storing it, so
+    // memory stays constant however long the flight is
+    void simulate(TrajectorySink& sink, uint32_t maxSteps = STREAMING_MAX_STEPS) const {
+        PROFILE_SCOPE("simulator.stream");
+        auto push = [&](const TrajectoryState& state) { sink.push(state); };
+        
+        sink.begin(data);
+        simulateLaunch(data, maxSteps, push);
+        sink.end();
+    }
+    
+    // Metrics-only run: closed form without drag, otherwise a one-lane pass
+    // of the drag kernel that keeps no trajectory. Nothing is allocated.
+    TrajectoryMetrics calculateMetrics() const;
+    
+    const TrajectoryStats& getStats() const { return stats; }
+    
+    float getMaxHeight() const { return stats.maxHeight; }
+    float getApexTime() const { return stats.apexTime; }
+    float getRange() const { return stats.range; }
+    float getFlightTime() const { return stats.flightTime; }
+    float getImpactSpeed() const { return stats.impactSpeed(); }
+    float getImpactAngle() const { return stats.impactAngle(); }
+    
+    void printResults(std::ostream& stream) const;
+    
+    const std::vector<Vector2D>& getTrajectoryPoints() const { return trajectoryPoints; }
+
+    // Draws the stored trajectory with S and L at the launch and impact
+    // points. The canvas extent must already include the trajectory.
+    void drawOn(TrajectoryCanvas& canvas, char32_t mark) const {
+        canvas.plot(trajectoryPoints, mark);
+        canvas.moveTo(0, 0, U'S');
+        canvas.moveTo(getRange(), 0, U'L');
+    }
+
+    void visualizeTrajectory(std::ostream& stream, int width = 80, int height = 25) const;
+    
+    void showTrajectoryData(std::ostream& stream) const;
+};
+
+// Structure-of-arrays launch set: one element per launch in each array, so
+// the batch kernels can walk all launches of a tile in lockstep.
+struct ProjectileBatch {
+    std::vector<float> initialVelocity;
+    std::vector<float> angle; // in degrees
+    std::vector<float> gravity;
+    std::vector<unsigned char> airResistance;
+    std::vector<float> dragCoefficient;
+    std::vector<float> mass;
+    std::vector<Integrator> integrator;
+    std::vector<float> tolerance;
+    std::vector<unsigned char> fastDrag;
+    std::vector<FloatPrecision> precision;
+    std::vector<float> azimuth;
+
+    size_t size() const { return initialVelocity.size(); }
+
+    void reserve(size_t n) {
+        initialVelocity.reserve(n);
+        angle.reserve(n);
+        gravity.reserve(n);
+        airResistance.reserve(n);
+        dragCoefficient.reserve(n);
+        mass.reserve(n);
+        integrator.reserve(n);
+        tolerance.reserve(n);
+        fastDrag.reserve(n);
+        precision.reserve(n);
+        azimuth.reserve(n);
+    }
+
+    void clear() {
+        initialVelocity.clear();
+        angle.clear();
+        gravity.clear();
+        airResistance.clear();
+        dragCoefficient.clear();
+        mass.clear();
+        integrator.clear();
+        tolerance.clear();
+        fastDrag.clear();
+        precision.clear();
+        azimuth.clear();
+    }
+
+    void add(const ProjectileData& data) {
+        initialVelocity.push_back(data.initialVelocity);
+        angle.push_back(data.angle);
+        gravity.push_back(data.gravity);
+        airResistance.push_back(data.airResistance ? 1 : 0);
+        dragCoefficient.push_back(data.dragCoefficient);
+        mass.push_back(data.mass);
+        integrator.push_back(data.integrator);
+        tolerance.push_back(data.tolerance);
+        fastDrag.push_back(data.fastDrag ? 1 : 0);
+        precision.push_back(data.precision);
+        azimuth.push_back(data.azimuth);
+    }
+
+    ProjectileData get(size_t i) const {
+        ProjectileData data;
+        data.initialVelocity = initialVelocity[i];
+        data.angle = angle[i];
+        data.gravity = gravity[i];
+        data.airResistance = airResistance[i] != 0;
+        data.dragCoefficient = dragCoefficient[i];
+        data.mass = mass[i];
+        data.integrator = integrator[i];
+        data.tolerance = tolerance[i];
+        data.fastDrag = fastDrag[i] != 0;
+        data.precision = precision[i];
+        data.azimuth = azimuth[i];
+        return data;
+    }
+};
+
+// Per-launch metrics for a batch, indexed like the ProjectileBatch arrays.
+struct BatchResults {
+    std::vector<float> maxHeight;
+    std::vector<float> range;
+    std::vector<float> flightTime;
+
+    size_t size() const { return range.size(); }
+
+    void resize(size_t n) {
+        maxHeight.resize(n);
+        range.resize(n);
+        flightTime.resize(n);
+    }
+};
+
+// Runs many launches per call. Launches are processed in tiles of TILE lanes.
+// Drag-free lanes use the closed-form metrics; drag lanes are gathered into
+// dense working arrays and stepped in lockstep until every lane has landed.
+// The results match ProjectileSimulator::calculateMetrics() exactly.
+class BatchSimulator {
+private:
+    static constexpr size_t TILE = 256;
+
+    // Working state for the lanes of the current tile
+    std::vector<size_t> lanes;
+    std::vector<float> x, y, vx, vy;
+    std::vector<float> gravity, dragFactor, mass, dragPerMass;
+    std::vector<float> maxY, range, flightTime;
+    std::vector<uint32_t> steps;
+    std::vector<uint32_t> active;
+
+    // Sizes the lane arrays to a multiple of the widest vector kernel; the
+    // padding lanes stay inactive with harmless values.
+    void prepare(size_t n);
+
+    void gather(const ProjectileBatch& batch);
+    void scatter(BatchResults& results) const;
+
+    // Same explicit Euler update as ProjectileSimulator::calculateNumerical(),
+    // run through the best available SIMD kernel
+    void stepNumerical(bool fast);
+
+public:
+    void run(const ProjectileBatch& batch, BatchResults& results) {
+        results.resize(batch.size());
+        run(batch, results, 0, batch.size());
+    }
+
+    // Computes launches [begin, end) into results, which must already be
+    // sized to the batch.
+    void run(const ProjectileBatch& batch, BatchResults& results, size_t begin, size_t end);
+};
+
+// Air density against altitude for EnvironmentSimulator, evaluated for a
+// whole tile of projectiles per call
+class AtmosphereModel {
+public:
+    virtual ~AtmosphereModel() {}
+    virtual void density(const float* altitude, float* density, size_t n) const = 0;
+};
+
+// Density tabulated at uniform altitude spacing and linearly interpolated,
+// so a lookup is a multiply, a truncation and one lerp into a table that
+// stays in L1. Altitudes outside the table clamp to its ends.
+class TabulatedAtmosphere : public AtmosphereModel {
+private:
+    float spacing, inverseSpacing;
+    std::vector<float> table; // density at altitude i * spacing
+
+public:
+    TabulatedAtmosphere(std::vector<float> table, float spacing)
+        : spacing(spacing), inverseSpacing(1 / spacing), table(std::move(table)) {
+        if (this->table.empty()) this->table.push_back(AIR_DENSITY);
+    }
+
+    // International Standard Atmosphere to 32 km every 50 m (troposphere
+    // lapse rate, isothermal layer from 11 km, +1 K/km from 20 km), with
+    // sea level at AIR_DENSITY
+    static const TabulatedAtmosphere& standard() {
+        static const TabulatedAtmosphere atmosphere = [] {
+            const double g = 9.80665, R = 287.053;
+            const double SPACING = 50, TOP = 32000;
+            std::vector<float> table;
+            for (double h = 0; h <= TOP; h += SPACING) {
+                double rho;
+                if (h <= 11000) {
+                    rho = AIR_DENSITY * std::pow(1 - 0.0065 * h / 288.15, g / (R * 0.0065) - 1);
+                } else {
+                    double rho11 = AIR_DENSITY * std::pow(216.65 / 288.15, g / (R * 0.0065) - 1);
+                    if (h <= 20000) {
+                        rho = rho11 * std::exp(-g * (h - 11000) / (R * 216.65));
+                    } else {
+                        double rho20 = rho11 * std::exp(-g * 9000 / (R * 216.65));
+                        rho = rho20 * std::pow(1 + 0.001 * (h - 20000) / 216.65, -g / (R * 0.001) - 1);
+                    }
+                }
+                table.push_back((float)rho);
+            }
+            return TabulatedAtmosphere(std::move(table), (float)SPACING);
+        }();
+        return atmosphere;
+    }
+
+    float densityAt(float altitude) const {
+        float position = std::min(std::max(altitude * inverseSpacing, 0.0f), (float)(table.size() - 1));
+        size_t i = std::min((size_t)position, table.size() - 1);
+        size_t next = std::min(i + 1, table.size() - 1);
+        float u = position - (float)i;
+        return table[i] + u * (table[next] - table[i]);
+    }
+
+    void density(const float* altitude, float* density, size_t n) const override {
+        for (size_t i = 0; i < n; i++) density[i] = densityAt(altitude[i]);
+    }
+};
+
+// Wind velocity at positions for EnvironmentSimulator, evaluated for a
+// whole tile of projectiles per call. Positions are relative to the launch
+// point: x and z span the ground, y is height above it.
+class WindModel {
+public:
+    virtual ~WindModel() {}
+    virtual void velocity(const float* x, const float* y, const float* z,
+                          float* u, float* v, float* w, size_t n) const = 0;
+};
+
+// Wind on a regular grid, trilinearly interpolated and constant beyond its
+// edges. Each node's (u, v, w) is padded to 16 bytes and nodes are stored
+// x-fastest, so the eight corners of a cell are four 32-byte pairs.
+class GriddedWind : public WindModel {
+private:
+    struct Node {
+        float u, v, w, pad;
+    };
+
+    int nx, ny, nz;
+    Vector3D origin, spacing, inverseSpacing;
+    std::vector<Node> nodes;
+
+    size_t index(int i, int j, int k) const { return ((size_t)k * ny + j) * nx + i; }
+
+    // Cell and fraction along one axis, clamped to the grid
+    static void locate(float coordinate, float origin, float inverse, int count, int& cell, int& next, float& u) {
+        float position = std::min(std::max((coordinate - origin) * inverse, 0.0f), (float)(count - 1));
+        cell = std::min((int)position, count - 1);
+        next = std::min(cell + 1, count - 1);
+        u = position - (float)cell;
+    }
+
+public:
+    GriddedWind(int nx, int ny, int nz, const Vector3D& origin, const Vector3D& spacing)
+        : nx(std::max(nx, 1)), ny(std::max(ny, 1)), nz(std::max(nz, 1)), origin(origin), spacing(spacing),
+          inverseSpacing(1 / spacing.x, 1 / spacing.y, 1 / spacing.z),
+          nodes((size_t)this->nx * this->ny * this->nz, Node{0, 0, 0, 0}) {}
+
+    static GriddedWind uniform(const Vector3D& wind) {
+        GriddedWind field(1, 1, 1, Vector3D(), Vector3D(1, 1, 1));
+        field.set(0, 0, 0, wind);
+        return field;
+    }
+
+    // Text grid: "nx ny nz", the origin "x y z", the spacing "dx dy dz",
+    // then nx * ny * nz node velocities "u v w" with x varying fastest and
+    // z slowest. '#' starts a comment.
+    static bool load(std::istream& in, std::unique_ptr<GriddedWind>& field, std::string& error);
+
+    void set(int i, int j, int k, const Vector3D& wind) {
+        nodes[index(i, j, k)] = Node{wind.x, wind.y, wind.z, 0};
+    }
+
+    Vector3D at(float x, float y, float z) const {
+        int i0, i1, j0, j1, k0, k1;
+        float u, v, w;
+        locate(x, origin.x, inverseSpacing.x, nx, i0, i1, u);
+        locate(y, origin.y, inverseSpacing.y, ny, j0, j1, v);
+        locate(z, origin.z, inverseSpacing.z, nz, k0, k1, w);
+
+        auto lerp = [](const Node& a, const Node& b, float t) {
+            return Node{a.u + t * (b.u - a.u), a.v + t * (b.v - a.v), a.w + t * (b.w - a.w), 0};
+        };
+        Node c00 = lerp(nodes[index(i0, j0, k0)], nodes[index(i1, j0, k0)], u);
+        Node c10 = lerp(nodes[index(i0, j1, k0)], nodes[index(i1, j1, k0)], u);
+        Node c01 = lerp(nodes[index(i0, j0, k1)], nodes[index(i1, j0, k1)], u);
+        Node c11 = lerp(nodes[index(i0, j1, k1)], nodes[index(i1, j1, k1)], u);
+        Node c = lerp(lerp(c00, c10, v), lerp(c01, c11, v), w);
+        return Vector3D(c.u, c.v, c.w);
+    }
+
+    void velocity(const float* x, const float* y, const float* z,
+                  float* u, float* v, float* w, size_t n) const override {
+        if (nodes.size() == 1) {
+            std::fill(u, u + n, nodes[0].u);
+            std::fill(v, v + n, nodes[0].v);
+            std::fill(w, w + n, nodes[0].w);
+            return;
+        }
+        for (size_t i = 0; i < n; i++) {
+            Vector3D wind = at(x[i], y[i], z[i]);
+            u[i] = wind.x;
+            v[i] = wind.y;
+            w[i] = wind.z;
+        }
+    }
+};
+
+// Air for EnvironmentSimulator. A null model means sea-level density
+// (AIR_DENSITY) or still air. groundAltitude is the altitude of the launch
+// point above sea level, added to the height for density lookups.
+struct Environment {
+    const AtmosphereModel* atmosphere;
+    const WindModel* wind;
+    float groundAltitude;
+
+    Environment() : atmosphere(nullptr), wind(nullptr), groundAltitude(0) {}
+};
+
+// Named environment (gravity, surface air density, exponential atmosphere
+// scale height). A density of 0 means no atmosphere, a scale height of 0
+// a uniform one.
+struct EnvironmentPreset {
+    std::string name;
+    float gravity;
+    float airDensity;  // kg/m³ at the surface
+    float scaleHeight; // m, density falls by 1/e per scale height
+};
+
+// Index of a preset in its registry; names are interned once when the
+// registry is built, so lookups in the sweep never compare strings
+typedef uint32_t PresetId;
+
+// Immutable set of environment presets. The process-wide registry is built
+// once, before any sweep runs, from the file the host passes to
+// initialize() or initializeFromEnvironment() (built-in planets otherwise),
+// and is only read afterwards, so worker threads share it without locking.
+class PresetRegistry {
+private:
+    std::vector<EnvironmentPreset> presets;
+    std::vector<TabulatedAtmosphere> atmospheres; // one per preset
+    std::unordered_map<std::string, PresetId> ids; // lower-case name -> id
+
+    static std::string key(const std::string& name) {
+        std::string lower = name;
+        for (char& c : lower) c = (char)std::tolower((unsigned char)c);
+        return lower;
+    }
+
+    // Density tabulated every 1/100 scale height up to 10 scale heights
+    static TabulatedAtmosphere tabulate(const EnvironmentPreset& preset) {
+        if (!(preset.airDensity > 0 && preset.scaleHeight > 0)) {
+            return TabulatedAtmosphere(std::vector<float>(1, preset.airDensity), 1.0f);
+        }
+        std::vector<float> table;
+        for (int i = 0; i <= 1000; i++) table.push_back((float)(preset.airDensity * std::exp(-i / 100.0)));
+        return TabulatedAtmosphere(std::move(table), preset.scaleHeight / 100);
+    }
+
+    bool add(const EnvironmentPreset& preset, std::string& error) {
+        if (!ids.emplace(key(preset.name), (PresetId)presets.size()).second) {
+            error = "duplicate preset '" + preset.name + "'";
+            return false;
+        }
+        presets.push_back(preset);
+        atmospheres.push_back(tabulate(preset));
+        return true;
+    }
+
+    static std::unique_ptr<const PresetRegistry>& pending() {
+        static std::unique_ptr<const PresetRegistry> registry;
+        return registry;
+    }
+
+    static std::atomic<bool>& inUse() {
+        static std::atomic<bool> used(false);
+        return used;
+    }
+
+    static const PresetRegistry* create();
+
+    bool loadFile(const std::string& path, std::string& error);
+
+public:
+    static constexpr PresetId NONE = UINT32_MAX;
+
+    static PresetRegistry builtin() {
+        static const EnvironmentPreset planets[] = {
+            {"Earth", 9.8f, 1.225f, 8500},
+            {"Moon", 1.62f, 0, 0},
+            {"Mars", 3.71f, 0.020f, 11100},
+            {"Jupiter", 24.79f, 0.16f, 27000},
+            {"Venus", 8.87f, 65.0f, 15900}
+        };
+        PresetRegistry registry;
+        std::string error;
+        for (const auto& planet : planets) registry.add(planet, error);
+        return registry;
+    }
+
+    // One preset per line: "name gravity [density [scale_height]]"; '#'
+    // starts a comment. Presets keep their file order.
+    bool load(std::istream& in, std::string& error);
+
+    // Installs the process-wide registry from a preset file. Must run at
+    // startup, before the first shared() call.
+    static bool initialize(const std::string& path, std::string& error) {
+        if (inUse()) {
+            error = "presets are already in use";
+            return false;
+        }
+        std::unique_ptr<PresetRegistry> registry(new PresetRegistry());
+        if (!registry->loadFile(path, error)) {
+            error = path + ": " + error;
+            return false;
+        }
+        pending().reset(registry.release());
+        return true;
+    }
+
+    // initialize() from the file named by the PROJECTILE_PRESETS environment
+    // variable, if it is set; on failure the built-in presets stay in place
+    static bool initializeFromEnvironment(std::string& error);
+
+    static const PresetRegistry& shared() {
+        static const PresetRegistry* registry = create();
+        return *registry;
+    }
+
+    size_t size() const { return presets.size(); }
+
+    // Case-insensitive; NONE when the name is unknown
+    PresetId find(const std::string& name) const {
+        auto it = ids.find(key(name));
+        if (it == ids.end()) return NONE;
+        return it->second;
+    }
+
+    const EnvironmentPreset& operator[](PresetId id) const { return presets[id]; }
+
+    // Exponential density profile of the preset, for Environment::atmosphere
+    const AtmosphereModel& atmosphere(PresetId id) const { return atmospheres[id]; }
+};
+
+// Per-launch results of an environment run. range is the impact distance
+// along the launch azimuth and drift the distance to its right (+z for
+// azimuth 0); both are signed.
+struct EnvironmentResults {
+    std::vector<float> maxHeight;
+    std::vector<float> range;
+    std::vector<float> drift;
+    std::vector<float> flightTime;
+
+    size_t size() const { return range.size(); }
+
+    void resize(size_t n) {
+        maxHeight.resize(n);
+        range.resize(n);
+        drift.resize(n);
+        flightTime.resize(n);
+    }
+};
+
+// Three-dimensional launches through an Environment, stepped in lockstep
+// with explicit Euler like BatchSimulator. Each step first evaluates the
+// density and wind for every projectile of a tile in one call per model,
+// then advances them all with drag on the air-relative velocity
+// -(0.5 rho Cd A / m) |v - wind| (v - wind). Landed projectiles are
+// compacted out, so lookups and updates always run over dense arrays.
+// Every launch uses this Euler scheme (integrator, fastDrag and precision
+// are ignored), and launches without air resistance feel neither drag nor
+// wind. In still sea-level air an azimuth-0 launch with air resistance,
+// the Euler integrator, single precision and exact drag gives exactly the
+// BatchSimulator result; other launches differ from it by the closed form
+// or integrator BatchSimulator uses for them.
+class EnvironmentSimulator {
+private:
+    static constexpr size_t TILE = 256;
+
+    std::vector<size_t> lanes;
+    std::vector<float> x, y, z, vx, vy, vz;
+    std::vector<float> gravity, dragCoefficient, mass, headingX, headingZ;
+    std::vector<float> maxY;
+    std::vector<uint32_t> steps;
+    std::vector<float> altitude, density, windX, windY, windZ;
+    std::vector<unsigned char> landed;
+
+    void gather(const ProjectileBatch& batch, size_t begin, size_t end);
+    void finish(size_t i, float impactX, float impactZ, float time, EnvironmentResults& results);
+
+    // Moves the lanes still in flight to the front; returns their count
+    size_t compact(size_t n);
+
+    // One Euler step of the first n lanes, the same operations in the same
+    // order as dragStepScalar() plus the z axis and the wind. The density
+    // and wind of all lanes are looked up first, one call per model.
+    void step(size_t n, const Environment& environment, float dt, EnvironmentResults& results);
+
+public:
+    void run(const ProjectileBatch& batch, const Environment& environment, EnvironmentResults& results) {
+        results.resize(batch.size());
+        run(batch, environment, results, 0, batch.size());
+    }
+
+    // Computes launches [begin, end) into results, which must already be
+    // sized to the batch
+    void run(const ProjectileBatch& batch, const Environment& environment, EnvironmentResults& results,
+             size_t begin, size_t end);
+};
+
+// Fixed set of worker threads that split an index range into chunks. Each
+// worker owns a deque of chunks seeded with a contiguous slice of the range;
+// it takes work from the front of its own deque and, once that is empty,
+// steals from the back of the other workers' deques. Long-running chunks
+// (drag launches) therefore cannot leave the other cores idle. The calling
+// thread takes part as worker 0.
+class WorkStealingPool {
+public:
+    typedef std::function<void(unsigned worker, size_t begin, size_t end)> ChunkFunction;
+
+private:
+    struct Chunk {
+        size_t begin, end;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Chunk> chunks;
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const ChunkFunction* job;
+    std::exception_ptr failure; // first exception thrown by job
+    uint64_t generation;
+    unsigned busyWorkers;
+    bool stopping;
+
+    bool popLocal(unsigned worker, Chunk& chunk) {
+        WorkQueue& queue = *queues[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.chunks.empty()) return false;
+        chunk = queue.chunks.front();
+        queue.chunks.pop_front();
+        return true;
+    }
+
+    bool steal(unsigned worker, Chunk& chunk) {
+        for (size_t offset = 1; offset < queues.size(); offset++) {
+            WorkQueue& victim = *queues[(worker + offset) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.chunks.empty()) continue;
+            chunk = victim.chunks.back();
+            victim.chunks.pop_back();
+            return true;
+        }
+        return false;
+    }
+
+    void drain(unsigned worker) {
+        Chunk chunk;
+        while (popLocal(worker, chunk) || steal(worker, chunk)) {
+            try {
+                (*job)(worker, chunk.begin, chunk.end);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!failure) failure = std::current_exception();
+            }
+        }
+    }
+
+    void workerLoop(unsigned worker) {
+        uint64_t seen = 0;
+        for (;;) {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            lock.unlock();
+
+            drain(worker);
+
+            lock.lock();
+            if (--busyWorkers == 0) finished.notify_all();
+        }
+    }
+
+public:
+    // threads == 0 uses one worker per hardware thread
+    explicit WorkStealingPool(unsigned threads = 0)
+        : job(nullptr), generation(0), busyWorkers(0), stopping(false) {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 0; i < threads; i++) {
+            queues.emplace_back(new WorkQueue());
+        }
+        for (unsigned i = 1; i < threads; i++) {
+            this->threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& thread : threads) thread.join();
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned size() const { return (unsigned)queues.size(); }
+
+    // Calls fn for consecutive chunks of at most chunkSize indices covering
+    // [0, count) and returns once all of them have completed. If fn throws,
+    // the other chunks still run, and the first exception is rethrown here
+    // once every worker is idle again.
+    void parallelFor(size_t count, size_t chunkSize, const ChunkFunction& fn) {
+        if (count == 0) return;
+        if (chunkSize == 0) chunkSize = 1;
+
+        size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+        size_t workers = queues.size();
+        for (size_t w = 0; w < workers; w++) {
+            std::lock_guard<std::mutex> lock(queues[w]->mutex);
+            for (size_t c = chunkCount * w / workers; c < chunkCount * (w + 1) / workers; c++) {
+                queues[w]->chunks.push_back({c * chunkSize, std::min(count, (c + 1) * chunkSize)});
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &fn;
+            busyWorkers = (unsigned)threads.size();
+            generation++;
+        }
+        wake.notify_all();
+
+        drain(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] { return busyWorkers == 0; });
+        job = nullptr;
+        if (failure) {
+            std::exception_ptr error = failure;
+            failure = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+// One axis of a sweep grid: count evenly spaced samples from first to last
+struct SweepAxis {
+    float first, last;
+    int count;
+
+    SweepAxis(float value = 0) : first(value), last(value), count(1) {}
+    SweepAxis(float first, float last, int count) : first(first), last(last), count(count) {}
+
+    float at(int i) const {
+        if (count <= 1) return first;
+        return first + (last - first) * i / (count - 1);
+    }
+};
+
+// Full-factorial (velocity, angle, gravity, drag coefficient) grid. Launches
+// are laid out with the drag coefficient varying fastest.
+struct SweepGrid {
+    SweepAxis velocity, angle, gravity, dragCoefficient;
+    bool airResistance;
+    float mass;
+
+    SweepGrid() : velocity(50.0f), angle(45.0f), gravity(9.8f), dragCoefficient(0.47f),
+                  airResistance(false), mass(1.0f) {}
+
+    size_t size() const {
+        return (size_t)velocity.count * angle.count * gravity.count * dragCoefficient.count;
+    }
+
+    ProjectileBatch build() const {
+        ProjectileBatch batch;
+        batch.reserve(size());
+
+        ProjectileData data;
+        data.airResistance = airResistance;
+        data.mass = mass;
+        for (int v = 0; v < velocity.count; v++) {
+            data.initialVelocity = velocity.at(v);
+            for (int a = 0; a < angle.count; a++) {
+                data.angle = angle.at(a);
+                for (int g = 0; g < gravity.count; g++) {
+                    data.gravity = gravity.at(g);
+                    for (int d = 0; d < dragCoefficient.count; d++) {
+                        data.dragCoefficient = dragCoefficient.at(d);
+                        batch.add(data);
+                    }
+                }
+            }
+        }
+        return batch;
+    }
+
+    // Launch k of build(), computed from the index alone
+    ProjectileData launch(size_t k) const {
+        ProjectileData data;
+        data.airResistance = airResistance;
+        data.mass = mass;
+        data.dragCoefficient = dragCoefficient.at((int)(k % dragCoefficient.count));
+        k /= dragCoefficient.count;
+        data.gravity = gravity.at((int)(k % gravity.count));
+        k /= gravity.count;
+        data.angle = angle.at((int)(k % angle.count));
+        data.initialVelocity = velocity.at((int)(k / angle.count));
+        return data;
+    }
+};
+
+// Runs a batch of launches across a work-stealing pool, one BatchSimulator
+// per worker, writing each launch's metrics into its slot of the output.
+class SweepRunner {
+private:
+    // Per-worker scratch for the launches of a chunk that missed the cache.
+    // Repeats of a missed launch within the chunk are simulated once.
+    struct Misses {
+        ProjectileBatch batch;
+        BatchResults results;
+        std::vector<LaunchKey> keys;
+        std::vector<std::pair<size_t, size_t>> targets; // (launch, miss slot)
+        std::unordered_map<LaunchKey, size_t, LaunchKeyHash> slots;
+    };
+
+    WorkStealingPool pool;
+    std::vector<BatchSimulator> simulators;
+    std::vector<EnvironmentSimulator> environmentSimulators;
+    std::vector<Misses> misses;
+    MetricsCache* cache;
+
+    void runCached(unsigned worker, const ProjectileBatch& launches, BatchResults& results,
+                   size_t begin, size_t end) {
+        Misses& m = misses[worker];
+        m.batch.clear();
+        m.keys.clear();
+        m.targets.clear();
+        m.slots.clear();
+
+        for (size_t i = begin; i < end; i++) {
+            ProjectileData data = launches.get(i);
+            LaunchKey key = cache->keyFor(data);
+            auto pending = m.slots.find(key);
+            if (pending != m.slots.end()) {
+                m.targets.emplace_back(i, pending->second);
+                continue;
+            }
+
+            TrajectoryMetrics metrics;
+            if (cache->lookup(key, metrics)) {
+                results.maxHeight[i] = metrics.maxHeight;
+                results.range[i] = metrics.range;
+                results.flightTime[i] = metrics.flightTime;
+            } else {
+                m.slots.emplace(key, m.batch.size());
+                m.targets.emplace_back(i, m.batch.size());
+                m.keys.push_back(key);
+                m.batch.add(data);
+            }
+        }
+        if (m.batch.size() == 0) return;
+
+        simulators[worker].run(m.batch, m.results);
+        for (size_t k = 0; k < m.keys.size(); k++) {
+            TrajectoryMetrics metrics;
+            metrics.maxHeight = m.results.maxHeight[k];
+            metrics.range = m.results.range[k];
+            metrics.flightTime = m.results.flightTime[k];
+            cache->insert(m.keys[k], metrics);
+        }
+        for (const auto& target : m.targets) {
+            results.maxHeight[target.first] = m.results.maxHeight[target.second];
+            results.range[target.first] = m.results.range[target.second];
+            results.flightTime[target.first] = m.results.flightTime[target.second];
+        }
+    }
+
+public:
+    static constexpr size_t DEFAULT_CHUNK = 512;
+
+    explicit SweepRunner(unsigned threads = 0)
+        : pool(threads), simulators(pool.size()), environmentSimulators(pool.size()), misses(pool.size()),
+          cache(nullptr) {}
+
+    unsigned threadCount() const { return pool.size(); }
+
+    // Optional shared metrics cache consulted before simulating each launch;
+    // nullptr disables it. The cache must outlive the runs that use it.
+    void setCache(MetricsCache* cache) { this->cache = cache; }
+
+    // results is resized only if it does not already match the batch, so a
+    // caller can keep reusing the same buffers across sweeps.
+    void run(const ProjectileBatch& launches, BatchResults& results, size_t chunkSize = DEFAULT_CHUNK) {
+        PROFILE_SCOPE("sweep.run");
+        if (results.size() != launches.size()) results.resize(launches.size());
+
+        pool.parallelFor(launches.size(), chunkSize, [&](unsigned worker, size_t begin, size_t end) {
+            if (cache) {
+                runCached(worker, launches, results, begin, end);
+            } else {
+                simulators[worker].run(launches, results, begin, end);
+            }
+        });
+    }
+
+    // 3D runs of the launches through environment (see
+    // EnvironmentSimulator). The metrics cache does not apply to them.
+    void run(const ProjectileBatch& launches, const Environment& environment, EnvironmentResults& results,
+             size_t chunkSize = DEFAULT_CHUNK) {
+        PROFILE_SCOPE("sweep.run_environment");
+        if (results.size() != launches.size()) results.resize(launches.size());
+
+        pool.parallelFor(launches.size(), chunkSize, [&](unsigned worker, size_t begin, size_t end) {
+            environmentSimulators[worker].run(launches, environment, results, begin, end);
+        });
+    }
+};
+
+enum class LaunchStatus {
+    Pending,   // queued or running
+    Finished,
+    Cancelled, // cancel() before the launch landed
+    TimedOut   // the deadline passed before the launch landed
+};
+
+struct AsyncLaunchResult {
+    LaunchStatus status;
+    TrajectoryStats stats; // valid when Finished
+};
+
+// State shared by an AsyncSimulator job and its LaunchFuture. Whoever
+// claims the job first (a worker starting it, cancel() or the deadline
+// timer while it is queued, or the simulator shutting down) completes it.
+struct AsyncLaunchJob {
+    typedef std::chrono::steady_clock Clock;
+
+    ProjectileData data;
+    Clock::time_point deadline;
+    TrajectorySink* sink;
+    std::atomic<bool> cancelled;
+    std::atomic<bool> claimed;
+
+    std::mutex mutex;
+    std::condition_variable done;
+    AsyncLaunchResult result;
+    std::function<void()> continuation; // run once when the result is set
+
+    AsyncLaunchJob(const ProjectileData& data, Clock::time_point deadline, TrajectorySink* sink)
+        : data(data), deadline(deadline), sink(sink), cancelled(false), claimed(false),
+          result{LaunchStatus::Pending, TrajectoryStats()} {}
+
+    // True for exactly one caller
+    bool claim() { return !claimed.exchange(true); }
+
+    // Sets the result and runs the continuation; only the claimant calls it
+    void complete(LaunchStatus status, const TrajectoryStats& stats) {
+        std::function<void()> next;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            result.status = status;
+            result.stats = stats;
+            next = std::move(continuation);
+        }
+        done.notify_all();
+        if (next) next();
+    }
+};
+
+// Handle to a launch submitted to an AsyncSimulator. get() and waitFor()
+// block; then() and co_await do not, and are resumed through the
+// simulator's dispatcher. Without one they run on the thread that
+// completes the launch: a compute thread, the deadline timer, or the
+// caller of cancel().
+class LaunchFuture {
+private:
+    std::shared_ptr<AsyncLaunchJob> job;
+    std::function<void(std::function<void()>)> dispatch;
+
+    // Registers continuation unless the result is already set
+    bool suspend(std::function<void()> continuation) {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        if (job->result.status != LaunchStatus::Pending) return false;
+        if (dispatch) {
+            auto resume = std::move(continuation);
+            auto post = dispatch;
+            job->continuation = [post, resume] { post(resume); };
+        } else {
+            job->continuation = std::move(continuation);
+        }
+        return true;
+    }
+
+public:
+    LaunchFuture() {}
+    LaunchFuture(std::shared_ptr<AsyncLaunchJob> job, std::function<void(std::function<void()>)> dispatch)
+        : job(std::move(job)), dispatch(std::move(dispatch)) {}
+
+    bool valid() const { return job != nullptr; }
+
+    bool ready() const {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        return job->result.status != LaunchStatus::Pending;
+    }
+
+    AsyncLaunchResult get() const {
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->done.wait(lock, [&] { return job->result.status != LaunchStatus::Pending; });
+        return job->result;
+    }
+
+    // Returns false if the launch is still pending after timeout
+    bool waitFor(std::chrono::nanoseconds timeout) const {
+        std::unique_lock<std::mutex> lock(job->mutex);
+        return job->done.wait_for(lock, timeout, [&] { return job->result.status != LaunchStatus::Pending; });
+    }
+
+    // A queued launch completes as Cancelled at once; a running one stops
+    // within AsyncSimulator::SLICE_STEPS steps. No effect once it has
+    // finished.
+    void cancel() {
+        job->cancelled = true;
+        if (job->claim()) job->complete(LaunchStatus::Cancelled, TrajectoryStats());
+    }
+
+    // Calls callback with the result once, immediately if it is already set.
+    // At most one then() or co_await per future.
+    void then(std::function<void(const AsyncLaunchResult&)> callback) {
+        std::shared_ptr<AsyncLaunchJob> shared = job;
+        auto deliver = [shared, callback] {
+            AsyncLaunchResult result;
+            {
+                std::lock_guard<std::mutex> lock(shared->mutex);
+                result = shared->result;
+            }
+            callback(result);
+        };
+        if (!suspend(deliver)) deliver();
+    }
+
+#if PROJECTILE_COROUTINES
+    // co_await future suspends the coroutine until the launch completes
+    bool await_ready() const { return ready(); }
+    bool await_suspend(std::coroutine_handle<> handle) {
+        return suspend([handle] { handle.resume(); });
+    }
+    AsyncLaunchResult await_resume() const { return get(); }
+#endif
+};
+
+// Runs launches on its own compute threads so callers (e.g. reactor
+// threads of an event loop) never block on the integration. Drag launches
+// stop between slices of SLICE_STEPS steps when cancelled or past their
+// deadline. A timer thread completes queued launches as TimedOut when
+// their deadline passes, however busy the workers are. Results
+// are the statistics the launch's states produce, the same as
+// ProjectileSimulator::getStats(); a sink, if given, also receives every
+// state on the compute thread.
+class AsyncSimulator {
+public:
+    typedef AsyncLaunchJob::Clock Clock;
+    // Schedules a continuation, e.g. by posting it to an event loop
+    typedef std::function<void(std::function<void()>)> Dispatcher;
+
+    static constexpr uint32_t SLICE_STEPS = 1024;
+
+private:
+    struct Deadline {
+        Clock::time_point time;
+        std::weak_ptr<AsyncLaunchJob> job;
+        bool operator<(const Deadline& other) const { return time > other.time; } // earliest on top
+    };
+
+    std::vector<std::thread> threads;
+    std::thread timer;
+    std::mutex mutex;
+    std::condition_variable wake, timerWake;
+    std::deque<std::shared_ptr<AsyncLaunchJob>> queue; // may hold jobs already claimed
+    std::vector<std::shared_ptr<AsyncLaunchJob>> running;
+    std::priority_queue<Deadline> deadlines;
+    Dispatcher dispatch;
+    bool stopping;
+
+    static LaunchStatus interruption(const AsyncLaunchJob& job) {
+        if (job.cancelled) return LaunchStatus::Cancelled;
+        if (job.deadline != Clock::time_point::max() && Clock::now() >= job.deadline) return LaunchStatus::TimedOut;
+        return LaunchStatus::Pending;
+    }
+
+    static void execute(AsyncLaunchJob& job) {
+        PROFILE_SCOPE("async.launch");
+        TrajectoryStats stats;
+        LaunchStatus status = interruption(job);
+        if (status == LaunchStatus::Pending) {
+            if (job.sink) job.sink->begin(job.data);
+            auto emit = [&](const TrajectoryState& state) {
+                stats.add(state);
+                if (job.sink) job.sink->push(state);
+            };
+            auto keepGoing = [&] {
+                status = interruption(job);
+                return status == LaunchStatus::Pending;
+            };
+            float flightTime = 0;
+            if (simulateLaunchInSlices(job.data, SLICE_STEPS, emit, keepGoing, flightTime)) {
+                stats.flightTime = flightTime;
+                status = LaunchStatus::Finished;
+            }
+            if (job.sink) job.sink->end();
+        }
+        job.complete(status, stats);
+    }
+
+    void workerLoop() {
+        for (;;) {
+            std::shared_ptr<AsyncLaunchJob> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || !queue.empty(); });
+                if (stopping) return;
+                job = std::move(queue.front());
+                queue.pop_front();
+                if (!job->claim()) continue;
+                running.push_back(job);
+            }
+            execute(*job);
+            std::lock_guard<std::mutex> lock(mutex);
+            running.erase(std::find(running.begin(), running.end(), job));
+        }
+    }
+
+    void timerLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            if (deadlines.empty()) {
+                timerWake.wait(lock);
+            } else if (Clock::now() < deadlines.top().time) {
+                timerWake.wait_until(lock, deadlines.top().time);
+            } else {
+                std::shared_ptr<AsyncLaunchJob> job = deadlines.top().job.lock();
+                deadlines.pop();
+                if (job && job->claim()) {
+                    lock.unlock();
+                    job->complete(LaunchStatus::TimedOut, TrajectoryStats());
+                    lock.lock();
+                }
+            }
+        }
+    }
+
+public:
+    // threads == 0 uses one worker per hardware thread
+    explicit AsyncSimulator(unsigned threads = 0, Dispatcher dispatch = nullptr)
+        : dispatch(std::move(dispatch)), stopping(false) {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 0; i < threads; i++) {
+            this->threads.emplace_back(&AsyncSimulator::workerLoop, this);
+        }
+        timer = std::thread(&AsyncSimulator::timerLoop, this);
+    }
+
+    // Launches still queued complete as Cancelled; running ones are
+    // cancelled and waited for. Launches submitted from here on (e.g. by a
+    // continuation) complete as Cancelled at once.
+    ~AsyncSimulator() {
+        std::deque<std::shared_ptr<AsyncLaunchJob>> dropped;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            dropped.swap(queue);
+            for (auto& job : running) job->cancelled = true;
+        }
+        wake.notify_all();
+        timerWake.notify_all();
+        for (auto& job : dropped) {
+            if (job->claim()) job->complete(LaunchStatus::Cancelled, TrajectoryStats());
+        }
+        for (auto& thread : threads) thread.join();
+        timer.join();
+    }
+
+    AsyncSimulator(const AsyncSimulator&) = delete;
+    AsyncSimulator& operator=(const AsyncSimulator&) = delete;
+
+    LaunchFuture submit(const ProjectileData& data, Clock::time_point deadline = Clock::time_point::max(),
+                        TrajectorySink* sink = nullptr) {
+        auto job = std::make_shared<AsyncLaunchJob>(data, deadline, sink);
+        bool accepted, earliest = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            accepted = !stopping;
+            if (accepted) {
+                queue.push_back(job);
+                if (deadline != Clock::time_point::max()) {
+                    earliest = deadlines.empty() || deadline < deadlines.top().time;
+                    deadlines.push(Deadline{deadline, job});
+                }
+            }
+        }
+        if (!accepted) {
+            job->claim();
+            job->complete(LaunchStatus::Cancelled, TrajectoryStats());
+            return LaunchFuture(job, dispatch);
+        }
+        wake.notify_one();
+        if (earliest) timerWake.notify_one();
+        return LaunchFuture(job, dispatch);
+    }
+
+    LaunchFuture submit(const ProjectileData& data, Clock::duration timeout, TrajectorySink* sink = nullptr) {
+        return submit(data, Clock::now() + timeout, sink);
+    }
+};
+
+// Count, mean and variance of a stream of values, by Welford's update.
+// Statistics of disjoint streams combine exactly with merge().
+struct RunningStatistics {
+    uint64_t count;
+    double mean, m2;
+    float min, max;
+
+    RunningStatistics() : count(0), mean(0), m2(0), min(INFINITY), max(-INFINITY) {}
+
+    void add(float value) {
+        count++;
+        double delta = value - mean;
+        mean += delta / count;
+        m2 += delta * (value - mean);
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+
+    void merge(const RunningStatistics& other) {
+        if (other.count == 0) return;
+        if (count == 0) {
+            *this = other;
+            return;
+        }
+        uint64_t total = count + other.count;
+        double delta = other.mean - mean;
+        mean += delta * other.count / total;
+        m2 += other.m2 + delta * delta * ((double)count * other.count / total);
+        count = total;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+
+    // Sample variance, 0 for fewer than two values
+    double variance() const { return count > 1 ? m2 / (count - 1) : 0; }
+    double standardDeviation() const { return std::sqrt(variance()); }
+};
+
+// Equal-width bins over [lo, hi). Values outside the range (and nan) are
+// only counted in underflow and overflow.
+struct Histogram {
+    float lo, hi;
+    std::vector<uint64_t> bins;
+    uint64_t underflow, overflow;
+
+    Histogram(float lo = 0, float hi = 1, size_t binCount = 0)
+        : lo(lo), hi(hi), bins(binCount, 0), underflow(0), overflow(0) {}
+
+    void add(float value) {
+        if (!(value >= lo)) {
+            underflow++;
+        } else if (value >= hi || bins.empty()) {
+            overflow++;
+        } else {
+            size_t bin = (size_t)((value - lo) / (hi - lo) * bins.size());
+            bins[std::min(bin, bins.size() - 1)]++;
+        }
+    }
+
+    // other must have the same range and bin count
+    void merge(const Histogram& other) {
+        for (size_t i = 0; i < bins.size(); i++) bins[i] += other.bins[i];
+        underflow += other.underflow;
+        overflow += other.overflow;
+    }
+
+    float binStart(size_t i) const { return lo + (hi - lo) * i / bins.size(); }
+
+    // Value below which fraction p of the counted values fall, interpolated
+    // within its bin; nan when it lies outside [lo, hi)
+    float quantile(double p) const {
+        uint64_t total = underflow + overflow;
+        for (uint64_t count : bins) total += count;
+        double target = p * total;
+        double below = (double)underflow;
+        if (total == 0 || target < below) return NAN;
+        for (size_t i = 0; i < bins.size(); i++) {
+            if (bins[i] > 0 && below + bins[i] >= target) {
+                return binStart(i) + (binStart(i + 1) - binStart(i)) * (float)((target - below) / bins[i]);
+            }
+            below += bins[i];
+        }
+        return NAN;
+    }
+};
+
+struct EnsembleMetric {
+    RunningStatistics statistics;
+    Histogram histogram;
+
+    void add(float value) {
+        statistics.add(value);
+        histogram.add(value);
+    }
+
+    void merge(const EnsembleMetric& other) {
+        statistics.merge(other.statistics);
+        histogram.merge(other.histogram);
+    }
+};
+
+// Everything an ensemble run returns: no per-launch results. The motion is
+// planar, so the impact point is the range and the miss distance is its
+// distance from the aim point along the range. With no cross-range
+// spread there is no circular error probable; the range error probable
+// (REP) is the half-width of the interval about the aim holding half the
+// impacts.
+struct EnsembleSummary {
+    EnsembleMetric maxHeight, range, flightTime;
+    EnsembleMetric miss;
+    float aimPoint;
+
+    EnsembleSummary() : aimPoint(0) {}
+
+    void add(float maxHeightValue, float rangeValue, float flightTimeValue) {
+        maxHeight.add(maxHeightValue);
+        range.add(rangeValue);
+        flightTime.add(flightTimeValue);
+        miss.add(std::fabs(rangeValue - aimPoint));
+    }
+
+    void merge(const EnsembleSummary& other) {
+        maxHeight.merge(other.maxHeight);
+        range.merge(other.range);
+        flightTime.merge(other.flightTime);
+        miss.merge(other.miss);
+    }
+
+    // Range miss distance containing fraction p of the impacts (0.5 for the REP)
+    float rangeError(double p) const { return miss.histogram.quantile(p); }
+};
+
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2,
+// 3"): a keyed bijection of a 128-bit counter. Each launch draws from its
+// own counters, so any thread or device can generate any launch's numbers
+// without shared generator state.
+inline void philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]) {
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int round = 0; round < 10; round++) {
+        uint64_t p0 = (uint64_t)0xD2511F53u * c0;
+        uint64_t p1 = (uint64_t)0xCD9E8D57u * c2;
+        uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c0 = n0;
+        c1 = (uint32_t)p1;
+        c2 = n2;
+        c3 = (uint32_t)p0;
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+// Four uniforms in (0, 1) for draw number stream of launch index
+inline void philoxUniforms(uint64_t seed, uint64_t index, uint32_t stream, double u[4]) {
+    uint32_t counter[4] = {(uint32_t)index, (uint32_t)(index >> 32), stream, 0};
+    uint32_t key[2] = {(uint32_t)seed, (uint32_t)(seed >> 32)};
+    uint32_t bits[4];
+    philox4x32(counter, key, bits);
+    for (int i = 0; i < 4; i++) u[i] = (bits[i] + 0.5) / 4294967296.0;
+}
+
+// Distribution of one launch parameter in an ensemble
+struct ParameterDistribution {
+    enum Kind {
+        Fixed,   // the nominal value
+        Normal,  // mean first, standard deviation second
+        Uniform  // between first and second
+    };
+
+    Kind kind;
+    float first, second;
+
+    ParameterDistribution(Kind kind = Fixed, float first = 0, float second = 0)
+        : kind(kind), first(first), second(second) {}
+
+    // u holds two independent uniforms in (0, 1)
+    float sample(float nominal, const double u[2]) const {
+        switch (kind) {
+        case Normal:
+            return first + second * (float)(std::sqrt(-2.0 * std::log(u[0])) * std::cos(6.283185307179586 * u[1]));
+        case Uniform:
+            return first + (second - first) * (float)u[0];
+        default:
+            return nominal;
+        }
+    }
+};
+
+// count launches around a nominal launch with velocity, angle, drag
+// coefficient and mass drawn from their distributions. Launch i depends
+// only on (seed, i), so an ensemble's results do not depend on how a
+// backend splits it up.
+struct EnsembleSpec {
+    ProjectileData nominal;
+    ParameterDistribution velocity, angle, dragCoefficient, mass;
+    uint64_t count;
+    uint64_t seed;
+    size_t histogramBins;
+    bool hasAimPoint;
+    float aimPoint; // impact x that miss distances are measured from
+
+    static constexpr size_t PILOT_LAUNCHES = 1024;
+    static constexpr size_t MISS_BINS = 4096;
+
+    EnsembleSpec() : count(0), seed(1), histogramBins(32), hasAimPoint(false), aimPoint(0) {}
+
+    // Perturbed drag coefficients are clamped at 0 and masses at 1 g
+    ProjectileData launch(uint64_t i) const {
+        double u[4], v[4];
+        philoxUniforms(seed, i, 0, u);
+        philoxUniforms(seed, i, 1, v);
+
+        ProjectileData data = nominal;
+        data.initialVelocity = velocity.sample(nominal.initialVelocity, u);
+        data.angle = angle.sample(nominal.angle, u + 2);
+        data.dragCoefficient = std::max(0.0f, dragCoefficient.sample(nominal.dragCoefficient, v));
+        data.mass = std::max(0.001f, mass.sample(nominal.mass, v + 2));
+        return data;
+    }
+
+    // Empty summary whose histograms span the values of the first
+    // PILOT_LAUNCHES launches, widened by half that span on each side. The
+    // aim point defaults to the nominal impact.
+    EnsembleSummary emptySummary() const {
+        ProjectileBatch pilot;
+        BatchResults results;
+        for (uint64_t i = 0; i < std::min<uint64_t>(count, PILOT_LAUNCHES); i++) pilot.add(launch(i));
+        BatchSimulator().run(pilot, results);
+
+        EnsembleSummary summary;
+        summary.aimPoint = hasAimPoint ? aimPoint : ProjectileSimulator(nominal).calculateMetrics().range;
+        summary.maxHeight.histogram = pilotHistogram(results.maxHeight, histogramBins);
+        summary.range.histogram = pilotHistogram(results.range, histogramBins);
+        summary.flightTime.histogram = pilotHistogram(results.flightTime, histogramBins);
+
+        std::vector<float> miss(results.range);
+        for (float& m : miss) m = std::fabs(m - summary.aimPoint);
+        summary.miss.histogram = pilotHistogram(miss, MISS_BINS);
+        summary.miss.histogram.lo = 0;
+        return summary;
+    }
+
+private:
+    static Histogram pilotHistogram(const std::vector<float>& values, size_t bins) {
+        if (values.empty()) return Histogram(0, 1, bins);
+        auto span = std::minmax_element(values.begin(), values.end());
+        float lo = *span.first, hi = *span.second;
+        float margin = std::max(0.5f * (hi - lo), 0.01f * std::max(std::fabs(lo), std::fabs(hi)) + 1e-6f);
+        return Histogram(lo - margin, hi + margin, bins);
+    }
+};
+
+// Where an ensemble is integrated. A backend hands back only the reduced
+// summary, so an accelerator backend can run one launch per device thread,
+// reduce on the device and copy back a few kilobytes whatever the size of
+// the ensemble.
+class EnsembleBackend {
+public:
+    virtual ~EnsembleBackend() {}
+    virtual const char* name() const = 0;
+    virtual EnsembleSummary run(const EnsembleSpec& spec) = 0;
+};
+
+// Runs ensembles on the CPU. The ensemble is cut into blocks that workers
+// generate, simulate through BatchSimulator and reduce to a partial
+// summary; memory use is bounded by the block size, not the ensemble. The
+// blocks depend only on the ensemble size and are merged in order, so the
+// summary is the same for any thread count.
+class CpuEnsembleBackend : public EnsembleBackend {
+private:
+    struct Scratch {
+        ProjectileBatch batch;
+        BatchResults results;
+    };
+
+    WorkStealingPool pool;
+    std::vector<BatchSimulator> simulators;
+    std::vector<Scratch> scratch;
+
+public:
+    static constexpr size_t MIN_BLOCK = 4096;
+    static constexpr size_t MAX_BLOCKS = 1024;
+
+    explicit CpuEnsembleBackend(unsigned threads = 0)
+        : pool(threads), simulators(pool.size()), scratch(pool.size()) {}
+
+    const char* name() const override { return "cpu"; }
+
+    EnsembleSummary run(const EnsembleSpec& spec) override {
+        PROFILE_SCOPE("ensemble.run");
+        EnsembleSummary empty = spec.emptySummary();
+        uint64_t block = std::max<uint64_t>(MIN_BLOCK, (spec.count + MAX_BLOCKS - 1) / MAX_BLOCKS);
+        size_t blockCount = (size_t)((spec.count + block - 1) / block);
+        std::vector<EnsembleSummary> partial(blockCount, empty);
+
+        pool.parallelFor(blockCount, 1, [&](unsigned worker, size_t begin, size_t end) {
+            Scratch& s = scratch[worker];
+            for (size_t b = begin; b < end; b++) {
+                uint64_t first = b * block;
+                uint64_t last = std::min(spec.count, first + block);
+                s.batch.clear();
+                s.batch.reserve((size_t)(last - first));
+                for (uint64_t i = first; i < last; i++) s.batch.add(spec.launch(i));
+
+                simulators[worker].run(s.batch, s.results);
+                for (size_t k = 0; k < s.batch.size(); k++) {
+                    partial[b].add(s.results.maxHeight[k], s.results.range[k], s.results.flightTime[k]);
+                }
+            }
+        });
+
+        for (const EnsembleSummary& p : partial) empty.merge(p);
+        return empty;
+    }
+};
+
+// Ensemble backends by name: "cpu", and "cuda" in libraries built with
+// PROJECTILE_CUDA. Fails when the name is unknown or its device is missing.
+std::unique_ptr<EnsembleBackend> makeEnsembleBackend(const std::string& name, unsigned threads,
+                                                     std::string& error);
+
+// One of count interleaved parts of a sweep for running it across
+// processes or machines without communication. Launch k belongs to shard
+// k % count, so neighbouring grid points, which cost about the same,
+// are spread over every shard and the shards take about equally long.
+struct SweepShard {
+    uint64_t index, count;
+    uint64_t fingerprint; // of the sweep, written into the shard file (see sweepFingerprint())
+
+    SweepShard(uint64_t index = 0, uint64_t count = 1) : index(index), count(count), fingerprint(0) {}
+
+    bool contains(uint64_t launch) const { return launch % count == index; }
+
+    // Launches of this shard among the first total
+    uint64_t size(uint64_t total) const { return total > index ? (total - index - 1) / count + 1 : 0; }
+
+    // Result file of the shard in directory, e.g. shard-00003-of-00016.pmt
+    std::string path(const std::string& directory) const;
+};
+
+// The launches of shard among those of batch, or of a grid or an ensemble
+// (generated directly, so the whole sweep is never held)
+ProjectileBatch selectShard(const ProjectileBatch& batch, SweepShard shard);
+ProjectileBatch selectShard(const SweepGrid& grid, SweepShard shard);
+ProjectileBatch selectShard(const EnsembleSpec& spec, SweepShard shard);
+
+// Identifies a sharded sweep: a hash of the shard count and everything that
+// determines the launches (every launch of a batch; the axes of a grid plus
+// the integrator, tolerance, fastDrag, precision and azimuth of settings,
+// which apply to all of them; the nominal launch, distributions, seed and
+// count of an ensemble). Never 0.
+uint64_t sweepFingerprint(const ProjectileBatch& launches, uint64_t shardCount);
+uint64_t sweepFingerprint(const SweepGrid& grid, const ProjectileData& settings, uint64_t shardCount);
+uint64_t sweepFingerprint(const EnsembleSpec& spec, uint64_t shardCount);
+
+// Shard results are trajectory files without columns: one record of
+// parameters and metrics per launch, in launch order, and the sweep's
+// fingerprint in the header. A file is written under a temporary name and
+// renamed into place once complete, so its presence marks the shard done
+// even when a worker is killed part way.
+
+// Whether the shard's file is complete, carries shard.fingerprint and holds
+// exactly launches, so a restarted run can skip it
+bool shardComplete(const std::string& directory, SweepShard shard, const ProjectileBatch& launches);
+
+// Runs the launches of a shard through runner and writes its file
+bool runShard(const std::string& directory, SweepShard shard, const ProjectileBatch& launches,
+              SweepRunner& runner, std::string& error);
+
+// Reduces the count shard files of directory to the statistics of every
+// launch in them. Histograms have bins equal-width bins spanning the
+// values seen; miss distances are measured from aimPoint, or the mean
+// range when it is null. Fails naming the missing shards if any are, with
+// the path and reader error of any shard file that exists but cannot be
+// read (e.g. truncated), and when the shards do not all carry the same
+// fingerprint.
+bool reduceShards(const std::string& directory, uint64_t count, size_t bins, const float* aimPoint,
+                  EnsembleSummary& summary, std::string& error);
+
+// Result of an angle search. metrics describe the launch at angle.
+struct AngleSolution {
+    bool found;
+    float angle; // in degrees
+    TrajectoryMetrics metrics;
+    int evaluations; // simulator runs spent in the search
+};
+
+// Angle in [0, 90] degrees that maximizes the range of launch. Near the
+// optimum the range is flat to second order, so the search stops once the
+// bracket is below tolerance degrees; without drag the answer is 45.
+AngleSolution solveOptimalAngle(const ProjectileData& launch, float tolerance = 0.01f);
+
+// Launch angle that makes launch pass through (targetX, targetY): the
+// flatter of the two solutions, or the steeper one with highArc. Not found
+// when the target is out of reach at every angle.
+AngleSolution solveAngleForTarget(const ProjectileData& launch, float targetX, float targetY,
+                                  bool highArc = false, float tolerance = 0.01f);
+
+const char* const LAUNCH_SPEC_FORMAT = "velocity angle [gravity [air [cd [mass [integrator]]]]] "
+                                      "(finite, gravity > 0, cd >= 0, mass > 0)";
+
+// Whole-string number and integrator-name parsers, shared by the launch
+// readers and the command line
+bool parseFloat(const std::string& text, float& value);
+bool parseCount(const std::string& text, uint64_t& value);
+bool parseIntegrator(const std::string& text, Integrator& integrator);
+
+// Whether the launch parameters are finite with gravity > 0, cd >= 0 and
+// mass > 0, the launches the simulators give meaningful results for
+bool launchValuesValid(float velocity, float angle, float gravity, float dragCoefficient, float mass);
+
+// Parses one launch in LAUNCH_SPEC_FORMAT; '#' starts a comment. Returns
+// false for a malformed line or invalid values (see launchValuesValid())
+// and sets blank for one without fields.
+bool parseLaunchSpec(std::string line, ProjectileData& data, bool& blank);
+
+// Reads one launch per non-empty line
+bool loadLaunchFile(std::istream& in, ProjectileBatch& batch, std::string& error);
+
+#if !defined(_WIN32)
+// Long-running simulation service. Clients send launches in
+// LAUNCH_SPEC_FORMAT, one per line, and get one reply line per launch in
+// request order: "max_height range flight_time" (shortest round-trip
+// decimal floats) or "error: ...". Blank and comment lines get no reply.
+// One thread polls every socket; all requests that arrive while a batch is
+// being simulated are coalesced into the next ProjectileBatch, which the
+// SweepRunner's pool spreads over the cores, so batches grow with load.
+class SimulationServer {
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+
+public:
+    explicit SimulationServer(unsigned threads = 0, size_t maxBatch = 65536);
+    ~SimulationServer();
+
+    SimulationServer(const SimulationServer&) = delete;
+    SimulationServer& operator=(const SimulationServer&) = delete;
+
+    // address is "PORT" (loopback), "HOST:PORT" (IPv4) or "unix:PATH"
+    bool listen(const std::string& address, std::string& error);
+
+    // Bound TCP port, e.g. after listening on port 0; 0 for a unix socket
+    int port() const;
+
+    // Serves until stop(); clients still connected are dropped
+    void run();
+
+    // Async-signal-safe; makes run() return
+    void stop();
+
+    uint64_t requests() const;
+    uint64_t batches() const;
+};
+#endif
+
+#endif // PROJECTILE_CORE_H
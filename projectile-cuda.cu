@@ -0,0 +1,344 @@
+// CUDA ensemble kernels for CudaEnsembleBackend (see projectile-cuda.h).
+// Every device thread draws and integrates its own launches, keeps Welford
+// statistics of them in registers and counts them into histograms in
+// shared memory. Each block then reduces its threads' statistics in a tree
+// and adds its histogram counts to the global ones, and a second kernel
+// merges the blocks' statistics in block order. Only the four merged
+// statistics and the histogram counts are copied back.
+//
+// The launch draws and the Euler step are those of EnsembleSpec::launch()
+// and dragStepScalar(), built with --fmad=false so that no multiply-add is
+// fused; sinf, cosf and the fast-drag rsqrtf round differently from the
+// host's, so results agree with the cpu backend to float rounding rather
+// than bit for bit.
+#include "projectile-cuda.h"
+
+#include <cuda_runtime.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const unsigned BLOCK = 256;     // threads per block, a power of two for the tree reduction
+const unsigned BLOCKS_PER_SM = 8;
+const size_t SHARED_SLOTS = 10240; // histogram slots that fit beside the reduction in 48 KiB
+
+// Histograms of the four metrics in one array: metric m has bins[m] bins
+// followed by its underflow and overflow counts, starting at offset[m]
+struct HistogramLayout {
+    float lo[DEVICE_METRICS], hi[DEVICE_METRICS];
+    unsigned bins[DEVICE_METRICS];
+    unsigned offset[DEVICE_METRICS + 1];
+};
+
+// RunningStatistics on the device
+struct Welford {
+    unsigned long long count;
+    double mean, m2;
+    float min, max;
+};
+
+__device__ void welfordReset(Welford& w) {
+    w.count = 0;
+    w.mean = 0;
+    w.m2 = 0;
+    w.min = INFINITY;
+    w.max = -INFINITY;
+}
+
+__device__ void welfordAdd(Welford& w, float value) {
+    w.count++;
+    double delta = value - w.mean;
+    w.mean += delta / w.count;
+    w.m2 += delta * (value - w.mean);
+    w.min = fminf(w.min, value);
+    w.max = fmaxf(w.max, value);
+}
+
+__device__ void welfordMerge(Welford& w, const Welford& other) {
+    if (other.count == 0) return;
+    if (w.count == 0) {
+        w = other;
+        return;
+    }
+    unsigned long long total = w.count + other.count;
+    double delta = other.mean - w.mean;
+    w.mean += delta * other.count / total;
+    w.m2 += other.m2 + delta * delta * ((double)w.count * other.count / total);
+    w.count = total;
+    w.min = fminf(w.min, other.min);
+    w.max = fmaxf(w.max, other.max);
+}
+
+// Slot of value in metric m's histogram, as Histogram::add() bins it
+__device__ unsigned histogramSlot(const HistogramLayout& layout, int m, float value) {
+    unsigned bins = layout.bins[m];
+    unsigned slot;
+    if (!(value >= layout.lo[m])) {
+        slot = bins;
+    } else if (value >= layout.hi[m] || bins == 0) {
+        slot = bins + 1;
+    } else {
+        slot = (unsigned)((value - layout.lo[m]) / (layout.hi[m] - layout.lo[m]) * (float)bins);
+        slot = min(slot, bins - 1);
+    }
+    return layout.offset[m] + slot;
+}
+
+// philox4x32() and philoxUniforms()
+__device__ void philoxUniforms(uint64_t seed, uint64_t index, uint32_t stream, double u[4]) {
+    uint32_t c0 = (uint32_t)index, c1 = (uint32_t)(index >> 32), c2 = stream, c3 = 0;
+    uint32_t k0 = (uint32_t)seed, k1 = (uint32_t)(seed >> 32);
+    for (int round = 0; round < 10; round++) {
+        uint64_t p0 = (uint64_t)0xD2511F53u * c0;
+        uint64_t p1 = (uint64_t)0xCD9E8D57u * c2;
+        uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c0 = n0;
+        c1 = (uint32_t)p1;
+        c2 = n2;
+        c3 = (uint32_t)p0;
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+    u[0] = (c0 + 0.5) / 4294967296.0;
+    u[1] = (c1 + 0.5) / 4294967296.0;
+    u[2] = (c2 + 0.5) / 4294967296.0;
+    u[3] = (c3 + 0.5) / 4294967296.0;
+}
+
+// ParameterDistribution::sample()
+__device__ float sample(const DeviceDistribution& d, float nominal, const double u[2]) {
+    switch (d.kind) {
+    case 1:
+        return d.first + d.second * (float)(sqrt(-2.0 * log(u[0])) * cos(6.283185307179586 * u[1]));
+    case 2:
+        return d.first + (d.second - d.first) * (float)u[0];
+    default:
+        return nominal;
+    }
+}
+
+// Launch i of the ensemble integrated to the ground: analyticalMetrics()
+// without drag, otherwise the Euler step of dragStepScalar() until landing
+// or maxSteps
+__device__ void simulate(const DeviceEnsemble& e, uint64_t i, float& maxHeight, float& range, float& flightTime) {
+    double u[4], v[4];
+    philoxUniforms(e.seed, i, 0, u);
+    philoxUniforms(e.seed, i, 1, v);
+    float velocity = sample(e.velocity, e.initialVelocity, u);
+    float angle = sample(e.angleDistribution, e.angle, u + 2);
+    float dragCoefficient = fmaxf(0.0f, sample(e.dragDistribution, e.dragCoefficient, v));
+    float mass = fmaxf(0.001f, sample(e.massDistribution, e.mass, v + 2));
+
+    float angleRad = angle * e.pi / 180.0f;
+    float vx = velocity * cosf(angleRad);
+    float vy = velocity * sinf(angleRad);
+    float g = e.gravity;
+
+    if (!e.airResistance) {
+        maxHeight = range = flightTime = 0;
+        if (vy <= 0 || g <= 0) return;
+        flightTime = 2.0f * vy / g;
+        maxHeight = vy * vy / (2.0f * g);
+        range = vx * flightTime;
+        return;
+    }
+
+    float dragFactor = 0.5f * e.airDensity * dragCoefficient * e.crossSectionArea;
+    float dragPerMass = dragFactor / mass;
+    float dt = e.dt;
+    float x = 0, y = 0, maxY = 0;
+    for (uint32_t steps = 1;; steps++) {
+        float px = x, py = y;
+        if (py > maxY) maxY = py;
+
+        float dragAccelX = 0, dragAccelY = 0;
+        if (e.fastDrag) {
+            float speedSquared = vx * vx + vy * vy;
+            float speed = speedSquared * rsqrtf(speedSquared);
+            if (speed > 0.001f) {
+                float dragPerSpeed = -dragPerMass * speed;
+                dragAccelX = dragPerSpeed * vx;
+                dragAccelY = dragPerSpeed * vy;
+            }
+        } else {
+            float speed = sqrtf(vx * vx + vy * vy);
+            float dragForce = dragFactor * speed * speed;
+            if (speed > 0.001f) {
+                dragAccelX = -(dragForce / mass) * (vx / speed);
+                dragAccelY = -(dragForce / mass) * (vy / speed);
+            }
+        }
+
+        vx += dragAccelX * dt;
+        vy += (dragAccelY - g) * dt;
+        x += vx * dt;
+        y += vy * dt;
+
+        float startTime = (steps - 1) * dt;
+        if (y < 0) {
+            float fraction = py / (py - y);
+            range = px + fraction * (x - px);
+            flightTime = startTime + fraction * dt;
+            break;
+        }
+        if (steps > e.maxSteps) {
+            range = px;
+            flightTime = startTime + dt;
+            break;
+        }
+    }
+    maxHeight = maxY;
+}
+
+// Simulates launches blockIdx.x * BLOCK + threadIdx.x + k * gridDim.x * BLOCK,
+// writes the block's statistics to blockStats[blockIdx.x * DEVICE_METRICS + m]
+// and adds its histogram counts to slots. sharedSlots is the number of
+// histogram slots counted in shared memory first, 0 to count straight into
+// slots.
+__global__ void __launch_bounds__(BLOCK)
+ensembleKernel(DeviceEnsemble e, HistogramLayout layout, unsigned sharedSlots,
+               Welford* blockStats, unsigned long long* slots) {
+    extern __shared__ unsigned blockSlots[];
+    __shared__ Welford reduction[BLOCK];
+    unsigned t = threadIdx.x;
+
+    for (unsigned s = t; s < sharedSlots; s += BLOCK) blockSlots[s] = 0;
+    __syncthreads();
+
+    Welford local[DEVICE_METRICS];
+    for (int m = 0; m < DEVICE_METRICS; m++) welfordReset(local[m]);
+
+    uint64_t stride = (uint64_t)gridDim.x * BLOCK;
+    for (uint64_t i = (uint64_t)blockIdx.x * BLOCK + t; i < e.count; i += stride) {
+        float value[DEVICE_METRICS];
+        simulate(e, i, value[DEVICE_MAX_HEIGHT], value[DEVICE_RANGE], value[DEVICE_FLIGHT_TIME]);
+        value[DEVICE_MISS] = fabsf(value[DEVICE_RANGE] - e.aimPoint);
+        for (int m = 0; m < DEVICE_METRICS; m++) {
+            welfordAdd(local[m], value[m]);
+            unsigned slot = histogramSlot(layout, m, value[m]);
+            if (sharedSlots) atomicAdd(&blockSlots[slot], 1u);
+            else atomicAdd(&slots[slot], 1ull);
+        }
+    }
+
+    for (int m = 0; m < DEVICE_METRICS; m++) {
+        reduction[t] = local[m];
+        __syncthreads();
+        for (unsigned half = BLOCK / 2; half > 0; half /= 2) {
+            if (t < half) welfordMerge(reduction[t], reduction[t + half]);
+            __syncthreads();
+        }
+        if (t == 0) blockStats[blockIdx.x * DEVICE_METRICS + m] = reduction[0];
+        __syncthreads();
+    }
+
+    for (unsigned s = t; s < sharedSlots; s += BLOCK) {
+        if (blockSlots[s]) atomicAdd(&slots[s], (unsigned long long)blockSlots[s]);
+    }
+}
+
+// Merges the blocks' statistics of metric threadIdx.x in block order, so the
+// result does not depend on block scheduling
+__global__ void mergeKernel(const Welford* blockStats, unsigned blocks, Welford* merged) {
+    unsigned m = threadIdx.x;
+    if (m >= DEVICE_METRICS) return;
+    Welford total;
+    welfordReset(total);
+    for (unsigned b = 0; b < blocks; b++) welfordMerge(total, blockStats[b * DEVICE_METRICS + m]);
+    merged[m] = total;
+}
+
+// Device allocation freed on scope exit
+template <typename T>
+struct DeviceBuffer {
+    T* data;
+
+    DeviceBuffer() : data(nullptr) {}
+    ~DeviceBuffer() {
+        if (data) cudaFree(data);
+    }
+    DeviceBuffer(const DeviceBuffer&) = delete;
+    DeviceBuffer& operator=(const DeviceBuffer&) = delete;
+
+    cudaError_t allocate(size_t count) { return cudaMalloc((void**)&data, count * sizeof(T)); }
+};
+
+bool succeeded(cudaError_t status, const char* what, std::string& error) {
+    if (status == cudaSuccess) return true;
+    error = std::string("CUDA ") + what + ": " + cudaGetErrorString(status);
+    return false;
+}
+
+} // namespace
+
+bool cudaEnsembleAvailable(std::string& error) {
+    int devices = 0;
+    if (!succeeded(cudaGetDeviceCount(&devices), "device query", error)) return false;
+    if (devices == 0) {
+        error = "no CUDA device found";
+        return false;
+    }
+    return true;
+}
+
+bool runCudaEnsemble(const DeviceEnsemble& ensemble, DeviceMetric metrics[DEVICE_METRICS], std::string& error) {
+    HistogramLayout layout;
+    layout.offset[0] = 0;
+    for (int m = 0; m < DEVICE_METRICS; m++) {
+        const DeviceHistogram& h = metrics[m].histogram;
+        layout.lo[m] = h.lo;
+        layout.hi[m] = h.hi;
+        layout.bins[m] = (unsigned)h.bins.size();
+        layout.offset[m + 1] = layout.offset[m] + layout.bins[m] + 2;
+    }
+    unsigned slotCount = layout.offset[DEVICE_METRICS];
+    unsigned sharedSlots = slotCount <= SHARED_SLOTS ? slotCount : 0;
+
+    int device = 0, processors = 1;
+    if (!succeeded(cudaGetDevice(&device), "device selection", error) ||
+        !succeeded(cudaDeviceGetAttribute(&processors, cudaDevAttrMultiProcessorCount, device), "device query", error)) {
+        return false;
+    }
+    uint64_t wanted = (ensemble.count + BLOCK - 1) / BLOCK;
+    unsigned blocks = (unsigned)std::max<uint64_t>(1, std::min<uint64_t>(wanted, (uint64_t)processors * BLOCKS_PER_SM));
+
+    DeviceBuffer<Welford> blockStats, merged;
+    DeviceBuffer<unsigned long long> slots;
+    if (!succeeded(blockStats.allocate((size_t)blocks * DEVICE_METRICS), "allocation", error) ||
+        !succeeded(merged.allocate(DEVICE_METRICS), "allocation", error) ||
+        !succeeded(slots.allocate(slotCount), "allocation", error) ||
+        !succeeded(cudaMemset(slots.data, 0, slotCount * sizeof(unsigned long long)), "memset", error)) {
+        return false;
+    }
+
+    ensembleKernel<<<blocks, BLOCK, sharedSlots * sizeof(unsigned)>>>(ensemble, layout, sharedSlots,
+                                                                      blockStats.data, slots.data);
+    mergeKernel<<<1, DEVICE_METRICS>>>(blockStats.data, blocks, merged.data);
+    if (!succeeded(cudaGetLastError(), "kernel launch", error)) return false;
+
+    Welford statistics[DEVICE_METRICS];
+    std::vector<unsigned long long> counts(slotCount);
+    if (!succeeded(cudaMemcpy(statistics, merged.data, sizeof(statistics), cudaMemcpyDeviceToHost), "copy", error) ||
+        !succeeded(cudaMemcpy(counts.data(), slots.data, slotCount * sizeof(unsigned long long),
+                              cudaMemcpyDeviceToHost), "copy", error)) {
+        return false;
+    }
+
+    for (int m = 0; m < DEVICE_METRICS; m++) {
+        DeviceMetric& metric = metrics[m];
+        metric.count = statistics[m].count;
+        metric.mean = statistics[m].mean;
+        metric.m2 = statistics[m].m2;
+        metric.min = statistics[m].min;
+        metric.max = statistics[m].max;
+
+        const unsigned long long* slot = counts.data() + layout.offset[m];
+        for (unsigned b = 0; b < layout.bins[m]; b++) metric.histogram.bins[b] = slot[b];
+        metric.histogram.underflow = slot[layout.bins[m]];
+        metric.histogram.overflow = slot[layout.bins[m] + 1];
+    }
+    return true;
+}
@@ -0,0 +1,58 @@
+// Interface of the CUDA ensemble kernels (projectile-cuda.cu), built into
+// the library with PROJECTILE_CUDA. It uses only plain structs so that nvcc
+// never compiles projectile-core.h; CudaEnsembleBackend in
+// projectile-core.cpp translates to and from EnsembleSpec and
+// EnsembleSummary. Internal to the library; not installed.
+#ifndef PROJECTILE_CUDA_H
+#define PROJECTILE_CUDA_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A ParameterDistribution: kind 0 fixed, 1 normal, 2 uniform
+struct DeviceDistribution {
+    int kind;
+    float first, second;
+};
+
+// Fixed-range histogram of one metric, as in Histogram
+struct DeviceHistogram {
+    float lo, hi;
+    std::vector<uint64_t> bins;
+    uint64_t underflow, overflow;
+};
+
+// Welford statistics and histogram of one metric, as in EnsembleMetric
+struct DeviceMetric {
+    uint64_t count;
+    double mean, m2;
+    float min, max;
+    DeviceHistogram histogram;
+};
+
+// An EnsembleSpec whose launches are Euler drag launches in single
+// precision, or drag-free
+struct DeviceEnsemble {
+    float initialVelocity, angle, gravity, dragCoefficient, mass;
+    bool airResistance, fastDrag;
+    DeviceDistribution velocity, angleDistribution, dragDistribution, massDistribution;
+    uint64_t count, seed;
+    float aimPoint;
+
+    // Physical and integration constants of projectile-core.h
+    float pi, airDensity, crossSectionArea, dt;
+    uint32_t maxSteps;
+};
+
+// Metrics of an ensemble in EnsembleSummary order
+enum DeviceMetricIndex { DEVICE_MAX_HEIGHT, DEVICE_RANGE, DEVICE_FLIGHT_TIME, DEVICE_MISS, DEVICE_METRICS };
+
+// Whether a CUDA device is usable; error says why not
+bool cudaEnsembleAvailable(std::string& error);
+
+// Runs ensemble on the current device into metrics, whose histograms give
+// the ranges and bin counts to fill (their counts are overwritten)
+bool runCudaEnsemble(const DeviceEnsemble& ensemble, DeviceMetric metrics[DEVICE_METRICS], std::string& error);
+
+#endif
@@ -0,0 +1,358 @@
+// Drag step kernels shared by BatchSimulator and the benchmark: the lane
+// layout, the scalar, AVX2, AVX-512 and NEON Euler steps over it, and the
+// runtime kernel choice. Internal to the library; not installed.
+#ifndef PROJECTILE_KERNELS_H
+#define PROJECTILE_KERNELS_H
+
+#include "projectile-core.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Lane arrays advanced by the drag step kernels. Every array holds at least
+// paddedCount elements; padding lanes are inactive. active[i] is all-ones for
+// a lane still in flight and zero once it has landed or hit the step cap;
+// range and flightTime are written when the lane finishes.
+struct DragLanes {
+    float* x;
+    float* y;
+    float* vx;
+    float* vy;
+    const float* gravity;
+    const float* dragFactor;
+    const float* mass;
+    const float* dragPerMass; // dragFactor / mass, used by the fast kernels
+    float* maxY;
+    float* range;
+    float* flightTime;
+    uint32_t* steps;
+    uint32_t* active;
+    size_t paddedCount;
+};
+
+// Advances every active lane by one explicit Euler step of size dt and
+// returns how many lanes are still active afterwards. A step that ends below
+// ground is cut at the exact zero crossing of the (linear) Euler segment.
+// Each kernel takes Fast = true for the fastDrag variant, which replaces the
+// square root and three divisions per step with an approximate reciprocal
+// square root (see fastRsqrt) and the precomputed dragPerMass.
+typedef size_t (*DragStepKernel)(const DragLanes& lanes, float dt);
+
+const size_t DRAG_LANE_PADDING = 16;
+
+template <bool Fast = false>
+size_t dragStepScalar(const DragLanes& l, float dt) {
+    size_t live = 0;
+    for (size_t i = 0; i < l.paddedCount; i++) {
+        if (!l.active[i]) continue;
+
+        float px = l.x[i], py = l.y[i];
+        if (py > l.maxY[i]) l.maxY[i] = py;
+        l.steps[i]++;
+
+        float dragAccelX = 0, dragAccelY = 0;
+        if (Fast) {
+            float speedSquared = l.vx[i] * l.vx[i] + l.vy[i] * l.vy[i];
+            float speed = speedSquared * fastRsqrt(speedSquared);
+            if (speed > 0.001f) {
+                float dragPerSpeed = -l.dragPerMass[i] * speed;
+                dragAccelX = dragPerSpeed * l.vx[i];
+                dragAccelY = dragPerSpeed * l.vy[i];
+            }
+        } else {
+            float speed = sqrt(l.vx[i] * l.vx[i] + l.vy[i] * l.vy[i]);
+            float dragForce = l.dragFactor[i] * speed * speed;
+            if (speed > 0.001f) {
+                dragAccelX = -(dragForce / l.mass[i]) * (l.vx[i] / speed);
+                dragAccelY = -(dragForce / l.mass[i]) * (l.vy[i] / speed);
+            }
+        }
+
+        l.vx[i] += dragAccelX * dt;
+        l.vy[i] += (dragAccelY - l.gravity[i]) * dt;
+
+        l.x[i] += l.vx[i] * dt;
+        l.y[i] += l.vy[i] * dt;
+
+        float startTime = (l.steps[i] - 1) * dt;
+        if (l.y[i] < 0) {
+            float fraction = py / (py - l.y[i]);
+            l.range[i] = px + fraction * (l.x[i] - px);
+            l.flightTime[i] = startTime + fraction * dt;
+            l.active[i] = 0;
+        } else if (l.steps[i] > MAX_NUMERICAL_STEPS) {
+            l.range[i] = px;
+            l.flightTime[i] = startTime + dt;
+            l.active[i] = 0;
+        } else {
+            live++;
+        }
+    }
+    return live;
+}
+
+// The vector kernels perform the same IEEE operations in the same order as
+// dragStepScalar() and are built with fp-contract=off (GCC would otherwise
+// fuse mul/add pairs into FMAs for AVX-512), so every exact kernel produces
+// the same results and the choice only affects speed.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PROJECTILE_SIMD_X86 1
+
+template <bool Fast = false>
+__attribute__((target("avx2"), optimize("fp-contract=off")))
+size_t dragStepAvx2(const DragLanes& l, float dt) {
+    const __m256 vdt = _mm256_set1_ps(dt);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 threeHalves = _mm256_set1_ps(1.5f);
+    const __m256 minSpeed = _mm256_set1_ps(0.001f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 signBit = _mm256_set1_ps(-0.0f);
+    const __m256i maxSteps = _mm256_set1_epi32((int)MAX_NUMERICAL_STEPS);
+    const __m256i one = _mm256_set1_epi32(1);
+    size_t live = 0;
+
+    for (size_t i = 0; i < l.paddedCount; i += 8) {
+        __m256i activeBits = _mm256_loadu_si256((const __m256i*)(l.active + i));
+        if (_mm256_testz_si256(activeBits, activeBits)) continue;
+        __m256 mask = _mm256_castsi256_ps(activeBits);
+
+        __m256 x = _mm256_loadu_ps(l.x + i);
+        __m256 y = _mm256_loadu_ps(l.y + i);
+        __m256 vx = _mm256_loadu_ps(l.vx + i);
+        __m256 vy = _mm256_loadu_ps(l.vy + i);
+
+        __m256 maxY = _mm256_loadu_ps(l.maxY + i);
+        _mm256_storeu_ps(l.maxY + i, _mm256_blendv_ps(maxY, _mm256_max_ps(y, maxY), mask));
+        __m256i steps = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(l.steps + i)), activeBits);
+        _mm256_storeu_si256((__m256i*)(l.steps + i), steps);
+
+        __m256 dragAccelX, dragAccelY;
+        if (Fast) {
+            __m256 speedSquared = _mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy));
+            __m256 r = _mm256_rsqrt_ps(speedSquared);
+            __m256 halfSquared = _mm256_mul_ps(half, speedSquared);
+            r = _mm256_mul_ps(r, _mm256_sub_ps(threeHalves, _mm256_mul_ps(_mm256_mul_ps(halfSquared, r), r)));
+            __m256 speed = _mm256_mul_ps(speedSquared, r);
+            __m256 moving = _mm256_cmp_ps(speed, minSpeed, _CMP_GT_OQ);
+            __m256 dragPerSpeed = _mm256_mul_ps(_mm256_xor_ps(_mm256_loadu_ps(l.dragPerMass + i), signBit), speed);
+            dragAccelX = _mm256_and_ps(moving, _mm256_mul_ps(dragPerSpeed, vx));
+            dragAccelY = _mm256_and_ps(moving, _mm256_mul_ps(dragPerSpeed, vy));
+        } else {
+            __m256 speed = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)));
+            __m256 dragForce = _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(l.dragFactor + i), speed), speed);
+            __m256 dragPerMass = _mm256_xor_ps(_mm256_div_ps(dragForce, _mm256_loadu_ps(l.mass + i)), signBit);
+            __m256 moving = _mm256_cmp_ps(speed, minSpeed, _CMP_GT_OQ);
+            dragAccelX = _mm256_and_ps(moving, _mm256_mul_ps(dragPerMass, _mm256_div_ps(vx, speed)));
+            dragAccelY = _mm256_and_ps(moving, _mm256_mul_ps(dragPerMass, _mm256_div_ps(vy, speed)));
+        }
+
+        __m256 nvx = _mm256_add_ps(vx, _mm256_mul_ps(dragAccelX, vdt));
+        __m256 nvy = _mm256_add_ps(vy, _mm256_mul_ps(_mm256_sub_ps(dragAccelY, _mm256_loadu_ps(l.gravity + i)), vdt));
+        __m256 nx = _mm256_add_ps(x, _mm256_mul_ps(nvx, vdt));
+        __m256 ny = _mm256_add_ps(y, _mm256_mul_ps(nvy, vdt));
+
+        _mm256_storeu_ps(l.vx + i, _mm256_blendv_ps(vx, nvx, mask));
+        _mm256_storeu_ps(l.vy + i, _mm256_blendv_ps(vy, nvy, mask));
+        _mm256_storeu_ps(l.x + i, _mm256_blendv_ps(x, nx, mask));
+        _mm256_storeu_ps(l.y + i, _mm256_blendv_ps(y, ny, mask));
+
+        __m256 landed = _mm256_and_ps(mask, _mm256_cmp_ps(ny, zero, _CMP_LT_OQ));
+        __m256 capped = _mm256_andnot_ps(landed, _mm256_and_ps(mask,
+                            _mm256_castsi256_ps(_mm256_cmpgt_epi32(steps, maxSteps))));
+        __m256 stillActive = _mm256_andnot_ps(_mm256_or_ps(landed, capped), mask);
+        _mm256_storeu_si256((__m256i*)(l.active + i), _mm256_castps_si256(stillActive));
+
+        if (!_mm256_testz_ps(_mm256_or_ps(landed, capped), _mm256_or_ps(landed, capped))) {
+            __m256 startTime = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(steps, one)), vdt);
+            __m256 fraction = _mm256_div_ps(y, _mm256_sub_ps(y, ny));
+            __m256 impactX = _mm256_add_ps(x, _mm256_mul_ps(fraction, _mm256_sub_ps(nx, x)));
+            __m256 impactTime = _mm256_add_ps(startTime, _mm256_mul_ps(fraction, vdt));
+
+            __m256 range = _mm256_blendv_ps(_mm256_loadu_ps(l.range + i), impactX, landed);
+            __m256 flightTime = _mm256_blendv_ps(_mm256_loadu_ps(l.flightTime + i), impactTime, landed);
+            range = _mm256_blendv_ps(range, x, capped);
+            flightTime = _mm256_blendv_ps(flightTime, _mm256_add_ps(startTime, vdt), capped);
+            _mm256_storeu_ps(l.range + i, range);
+            _mm256_storeu_ps(l.flightTime + i, flightTime);
+        }
+        live += __builtin_popcount(_mm256_movemask_ps(stillActive));
+    }
+    return live;
+}
+
+template <bool Fast = false>
+__attribute__((target("avx512f"), optimize("fp-contract=off")))
+size_t dragStepAvx512(const DragLanes& l, float dt) {
+    const __m512 vdt = _mm512_set1_ps(dt);
+    const __m512 half = _mm512_set1_ps(0.5f);
+    const __m512 threeHalves = _mm512_set1_ps(1.5f);
+    const __m512 minSpeed = _mm512_set1_ps(0.001f);
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512i allOnes = _mm512_set1_epi32(-1);
+    const __m512i maxSteps = _mm512_set1_epi32((int)MAX_NUMERICAL_STEPS);
+    const __m512i one = _mm512_set1_epi32(1);
+    size_t live = 0;
+
+    for (size_t i = 0; i < l.paddedCount; i += 16) {
+        __m512i activeBits = _mm512_loadu_si512(l.active + i);
+        __mmask16 mask = _mm512_test_epi32_mask(activeBits, activeBits);
+        if (!mask) continue;
+
+        __m512 x = _mm512_loadu_ps(l.x + i);
+        __m512 y = _mm512_loadu_ps(l.y + i);
+        __m512 vx = _mm512_loadu_ps(l.vx + i);
+        __m512 vy = _mm512_loadu_ps(l.vy + i);
+
+        __m512 maxY = _mm512_loadu_ps(l.maxY + i);
+        _mm512_storeu_ps(l.maxY + i, _mm512_mask_max_ps(maxY, mask, y, maxY));
+        __m512i steps = _mm512_mask_sub_epi32(_mm512_loadu_si512(l.steps + i), mask,
+                                              _mm512_loadu_si512(l.steps + i), allOnes);
+        _mm512_storeu_si512(l.steps + i, steps);
+
+        __m512 dragAccelX, dragAccelY;
+        if (Fast) {
+            __m512 speedSquared = _mm512_add_ps(_mm512_mul_ps(vx, vx), _mm512_mul_ps(vy, vy));
+            __m512 r = _mm512_rsqrt14_ps(speedSquared);
+            __m512 halfSquared = _mm512_mul_ps(half, speedSquared);
+            r = _mm512_mul_ps(r, _mm512_sub_ps(threeHalves, _mm512_mul_ps(_mm512_mul_ps(halfSquared, r), r)));
+            __m512 speed = _mm512_mul_ps(speedSquared, r);
+            __mmask16 moving = _mm512_cmp_ps_mask(speed, minSpeed, _CMP_GT_OQ);
+            __m512 dragPerSpeed = _mm512_mul_ps(_mm512_sub_ps(zero, _mm512_loadu_ps(l.dragPerMass + i)), speed);
+            dragAccelX = _mm512_maskz_mul_ps(moving, dragPerSpeed, vx);
+            dragAccelY = _mm512_maskz_mul_ps(moving, dragPerSpeed, vy);
+        } else {
+            __m512 speed = _mm512_sqrt_ps(_mm512_add_ps(_mm512_mul_ps(vx, vx), _mm512_mul_ps(vy, vy)));
+            __m512 dragForce = _mm512_mul_ps(_mm512_mul_ps(_mm512_loadu_ps(l.dragFactor + i), speed), speed);
+            __m512 dragPerMass = _mm512_sub_ps(zero, _mm512_div_ps(dragForce, _mm512_loadu_ps(l.mass + i)));
+            __mmask16 moving = _mm512_cmp_ps_mask(speed, minSpeed, _CMP_GT_OQ);
+            dragAccelX = _mm512_maskz_mul_ps(moving, dragPerMass, _mm512_div_ps(vx, speed));
+            dragAccelY = _mm512_maskz_mul_ps(moving, dragPerMass, _mm512_div_ps(vy, speed));
+        }
+
+        __m512 nvx = _mm512_add_ps(vx, _mm512_mul_ps(dragAccelX, vdt));
+        __m512 nvy = _mm512_add_ps(vy, _mm512_mul_ps(_mm512_sub_ps(dragAccelY, _mm512_loadu_ps(l.gravity + i)), vdt));
+        __m512 nx = _mm512_add_ps(x, _mm512_mul_ps(nvx, vdt));
+        __m512 ny = _mm512_add_ps(y, _mm512_mul_ps(nvy, vdt));
+
+        _mm512_mask_storeu_ps(l.vx + i, mask, nvx);
+        _mm512_mask_storeu_ps(l.vy + i, mask, nvy);
+        _mm512_mask_storeu_ps(l.x + i, mask, nx);
+        _mm512_mask_storeu_ps(l.y + i, mask, ny);
+
+        __mmask16 landed = mask & _mm512_cmp_ps_mask(ny, zero, _CMP_LT_OQ);
+        __mmask16 capped = mask & (__mmask16)~landed & _mm512_cmpgt_epi32_mask(steps, maxSteps);
+        __mmask16 stillActive = mask & (__mmask16)~(landed | capped);
+        _mm512_storeu_si512(l.active + i, _mm512_maskz_mov_epi32(stillActive, allOnes));
+
+        if (landed | capped) {
+            __m512 startTime = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_sub_epi32(steps, one)), vdt);
+            __m512 fraction = _mm512_div_ps(y, _mm512_sub_ps(y, ny));
+            __m512 impactX = _mm512_add_ps(x, _mm512_mul_ps(fraction, _mm512_sub_ps(nx, x)));
+            __m512 impactTime = _mm512_add_ps(startTime, _mm512_mul_ps(fraction, vdt));
+
+            _mm512_mask_storeu_ps(l.range + i, landed, impactX);
+            _mm512_mask_storeu_ps(l.flightTime + i, landed, impactTime);
+            _mm512_mask_storeu_ps(l.range + i, capped, x);
+            _mm512_mask_storeu_ps(l.flightTime + i, capped, _mm512_add_ps(startTime, vdt));
+        }
+        live += __builtin_popcount(stillActive);
+    }
+    return live;
+}
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define PROJECTILE_SIMD_NEON 1
+
+template <bool Fast = false>
+__attribute__((optimize("fp-contract=off")))
+size_t dragStepNeon(const DragLanes& l, float dt) {
+    const float32x4_t vdt = vdupq_n_f32(dt);
+    const float32x4_t minSpeed = vdupq_n_f32(0.001f);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const uint32x4_t maxSteps = vdupq_n_u32(MAX_NUMERICAL_STEPS);
+    size_t live = 0;
+
+    for (size_t i = 0; i < l.paddedCount; i += 4) {
+        uint32x4_t mask = vld1q_u32(l.active + i);
+        if (vmaxvq_u32(mask) == 0) continue;
+
+        float32x4_t x = vld1q_f32(l.x + i);
+        float32x4_t y = vld1q_f32(l.y + i);
+        float32x4_t vx = vld1q_f32(l.vx + i);
+        float32x4_t vy = vld1q_f32(l.vy + i);
+
+        float32x4_t maxY = vld1q_f32(l.maxY + i);
+        vst1q_f32(l.maxY + i, vbslq_f32(vandq_u32(mask, vcgtq_f32(y, maxY)), y, maxY));
+        uint32x4_t steps = vsubq_u32(vld1q_u32(l.steps + i), mask);
+        vst1q_u32(l.steps + i, steps);
+
+        float32x4_t dragAccelX, dragAccelY;
+        if (Fast) {
+            float32x4_t speedSquared = vaddq_f32(vmulq_f32(vx, vx), vmulq_f32(vy, vy));
+            float32x4_t r = vrsqrteq_f32(speedSquared);
+            r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(speedSquared, r), r));
+            r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(speedSquared, r), r));
+            float32x4_t speed = vmulq_f32(speedSquared, r);
+            uint32x4_t moving = vcgtq_f32(speed, minSpeed);
+            float32x4_t dragPerSpeed = vmulq_f32(vnegq_f32(vld1q_f32(l.dragPerMass + i)), speed);
+            dragAccelX = vbslq_f32(moving, vmulq_f32(dragPerSpeed, vx), zero);
+            dragAccelY = vbslq_f32(moving, vmulq_f32(dragPerSpeed, vy), zero);
+        } else {
+            float32x4_t speed = vsqrtq_f32(vaddq_f32(vmulq_f32(vx, vx), vmulq_f32(vy, vy)));
+            float32x4_t dragForce = vmulq_f32(vmulq_f32(vld1q_f32(l.dragFactor + i), speed), speed);
+            float32x4_t dragPerMass = vnegq_f32(vdivq_f32(dragForce, vld1q_f32(l.mass + i)));
+            uint32x4_t moving = vcgtq_f32(speed, minSpeed);
+            dragAccelX = vbslq_f32(moving, vmulq_f32(dragPerMass, vdivq_f32(vx, speed)), zero);
+            dragAccelY = vbslq_f32(moving, vmulq_f32(dragPerMass, vdivq_f32(vy, speed)), zero);
+        }
+
+        float32x4_t nvx = vaddq_f32(vx, vmulq_f32(dragAccelX, vdt));
+        float32x4_t nvy = vaddq_f32(vy, vmulq_f32(vsubq_f32(dragAccelY, vld1q_f32(l.gravity + i)), vdt));
+        float32x4_t nx = vaddq_f32(x, vmulq_f32(nvx, vdt));
+        float32x4_t ny = vaddq_f32(y, vmulq_f32(nvy, vdt));
+
+        vst1q_f32(l.vx + i, vbslq_f32(mask, nvx, vx));
+        vst1q_f32(l.vy + i, vbslq_f32(mask, nvy, vy));
+        vst1q_f32(l.x + i, vbslq_f32(mask, nx, x));
+        vst1q_f32(l.y + i, vbslq_f32(mask, ny, y));
+
+        uint32x4_t landed = vandq_u32(mask, vcltq_f32(ny, zero));
+        uint32x4_t capped = vbicq_u32(vandq_u32(mask, vcgtq_u32(steps, maxSteps)), landed);
+        uint32x4_t finished = vorrq_u32(landed, capped);
+        uint32x4_t stillActive = vbicq_u32(mask, finished);
+        vst1q_u32(l.active + i, stillActive);
+
+        if (vmaxvq_u32(finished) != 0) {
+            float32x4_t startTime = vmulq_f32(vcvtq_f32_u32(vsubq_u32(steps, vdupq_n_u32(1))), vdt);
+            float32x4_t fraction = vdivq_f32(y, vsubq_f32(y, ny));
+            float32x4_t impactX = vaddq_f32(x, vmulq_f32(fraction, vsubq_f32(nx, x)));
+            float32x4_t impactTime = vaddq_f32(startTime, vmulq_f32(fraction, vdt));
+
+            float32x4_t range = vbslq_f32(landed, impactX, vld1q_f32(l.range + i));
+            float32x4_t flightTime = vbslq_f32(landed, impactTime, vld1q_f32(l.flightTime + i));
+            vst1q_f32(l.range + i, vbslq_f32(capped, x, range));
+            vst1q_f32(l.flightTime + i, vbslq_f32(capped, vaddq_f32(startTime, vdt), flightTime));
+        }
+        live += vaddvq_u32(vshrq_n_u32(stillActive, 31));
+    }
+    return live;
+}
+#endif
+
+struct DragKernelInfo {
+    DragStepKernel step;
+    DragStepKernel fastStep;
+    const char* name;
+};
+
+// Picks the widest kernel the running CPU supports. PROJECTILE_SIMD=scalar
+// (or avx2, avx512, neon) forces a specific kernel when it is available.
+DragKernelInfo selectDragKernel();
+
+const DragKernelInfo& activeDragKernel();
+
+#endif // PROJECTILE_KERNELS_H
@@ -1,217 +1,10 @@
-#include <iostream>
-#include <cmath>
-#include <vector>
-#include <iomanip>
-
-const float PI = 3.14159265f;
-
-struct Vector2D {
-    float x, y;
-    Vector2D(float x = 0, float y = 0) : x(x), y(y) {}
-};
+#include "projectile-core.h"
 
-struct ProjectileData {
-    float initialVelocity;
-    float angle; // in degrees
-    float gravity;
-    bool airResistance;
-    float dragCoefficient;
-    float mass;
-    
-    ProjectileData() : initialVelocity(50.0f), angle(45.0f), gravity(9.8f), 
-                       airResistance(false), dragCoefficient(0.47f), mass(1.0f) {}
-};
-
-class ProjectileSimulator {
-private:
-    ProjectileData data;
-    std::vector<Vector2D> trajectoryPoints;
-    
-public:
-    ProjectileSimulator(const ProjectileData& data) : data(data) {}
-    
-    void calculateTrajectory() {
-        trajectoryPoints.clear();
-        
-        if (!data.airResistance) {
-            calculateAnalytical();
-        } else {
-            calculateNumerical();
-        }
-    }
-    
-    void calculateAnalytical() {
-        float angleRad = data.angle * PI / 180.0f;
-        float vx = data.initialVelocity * cos(angleRad);
-        float vy = data.initialVelocity * sin(angleRad);
-        
-        float totalTime = 2.0f * vy / data.gravity;
-        float dt = 0.02f;
-        
-        for (float t = 0; t <= totalTime; t += dt) {
-            float x = vx * t;
-            float y = vy * t - 0.5f * data.gravity * t * t;
-            
-            if (y < 0) break;
-            trajectoryPoints.push_back(Vector2D(x, y));
-        }
-    }
-    
-    void calculateNumerical() {
-        float angleRad = data.angle * PI / 180.0f;
-        float vx = data.initialVelocity * cos(angleRad);
-        float vy = data.initialVelocity * sin(angleRad);
-        
-        float x = 0, y = 0;
-        float dt = 0.01f;
-        
-        const float AIR_DENSITY = 1.225f;
-        const float CROSS_SECTION_AREA = 0.01f;
-        
-        while (y >= 0) {
-            trajectoryPoints.push_back(Vector2D(x, y));
-            
-            float speed = sqrt(vx * vx + vy * vy);
-            float dragForce = 0.5f * AIR_DENSITY * data.dragCoefficient * 
-                             CROSS_SECTION_AREA * speed * speed;
-            
-            float dragAccelX = 0, dragAccelY = 0;
-            if (speed > 0.001f) {
-                dragAccelX = -(dragForce / data.mass) * (vx / speed);
-                dragAccelY = -(dragForce / data.mass) * (vy / speed);
-            }
-            
-            vx += dragAccelX * dt;
-            vy += (dragAccelY - data.gravity) * dt;
-            
-            x += vx * dt;
-            y += vy * dt;
-            
-            if (trajectoryPoints.size() > 10000) break;
-        }
-    }
-    
-    float getMaxHeight() const {
-        float maxH = 0;
-        for (const auto& point : trajectoryPoints) {
-            if (point.y > maxH) maxH = point.y;
-        }
-        return maxH;
-    }
-    
-    float getRange() const {
-        if (trajectoryPoints.empty()) return 0;
-        return trajectoryPoints.back().x;
-    }
-    
-    float getFlightTime() const {
-        return trajectoryPoints.size() * (data.airResistance ? 0.01f : 0.02f);
-    }
-    
-    void printResults() const {
-        std::cout << "\n╔════════════════════════════════════════╗\n";
-        std::cout << "║   PROJECTILE MOTION SIMULATOR          ║\n";
-        std::cout << "╚════════════════════════════════════════╝\n\n";
-        
-        std::cout << "📊 INPUT PARAMETERS:\n";
-        std::cout << "├─ Initial Velocity: " << data.initialVelocity << " m/s\n";
-        std::cout << "├─ Launch Angle: " << data.angle << "°\n";
-        std::cout << "├─ Gravity: " << data.gravity << " m/s²\n";
-        std::cout << "└─ Air Resistance: " << (data.airResistance ? "ON" : "OFF") << "\n\n";
-        
-        std::cout << "📈 RESULTS:\n";
-        std::cout << "├─ Maximum Height: " << std::fixed << std::setprecision(2) 
-                  << getMaxHeight() << " m\n";
-        std::cout << "├─ Range: " << getRange() << " m\n";
-        std::cout << "├─ Flight Time: " << getFlightTime() << " s\n";
-        
-        if (!data.airResistance) {
-            float angleRad = data.angle * PI / 180.0f;
-            float impactVelocity = data.initialVelocity;
-            std::cout << "└─ Impact Velocity: " << impactVelocity << " m/s\n\n";
-        } else {
-            std::cout << "└─ (Air resistance affects impact velocity)\n\n";
-        }
-    }
-    
-    void visualizeTrajectory() const {
-        std::cout << "🎯 TRAJECTORY VISUALIZATION:\n\n";
-        
-        const int WIDTH = 80;
-        const int HEIGHT = 25;
-        
-        char canvas[HEIGHT][WIDTH];
-        for (int i = 0; i < HEIGHT; i++) {
-            for (int j = 0; j < WIDTH; j++) {
-                canvas[i][j] = ' ';
-            }
-        }
-        
-        // Draw ground
-        for (int j = 0; j < WIDTH; j++) {
-            canvas[HEIGHT-1][j] = '─';
-        }
-        
-        // Find max values for scaling
-        float maxX = getRange();
-        float maxY = getMaxHeight();
-        
-        // Plot trajectory
-        for (const auto& point : trajectoryPoints) {
-            int x = (int)((point.x / maxX) * (WIDTH - 1));
-            int y = HEIGHT - 2 - (int)((point.y / maxY) * (HEIGHT - 2));
-            
-            if (x >= 0 && x < WIDTH && y >= 0 && y < HEIGHT - 1) {
-                canvas[y][x] = '*';
-            }
-        }
-        
-        // Mark starting point
-        canvas[HEIGHT-2][0] = 'S';
-        
-        // Mark landing point
-        int endX = (int)((getRange() / maxX) * (WIDTH - 1));
-        if (endX < WIDTH - 1) {
-            canvas[HEIGHT-2][endX] = 'L';
-        }
-        
-        // Print canvas
-        std::cout << "  ┌" << std::string(WIDTH, '─') << "┐\n";
-        for (int i = 0; i < HEIGHT; i++) {
-            std::cout << "  │";
-            for (int j = 0; j < WIDTH; j++) {
-                std::cout << canvas[i][j];
-            }
-            std::cout << "│\n";
-        }
-        std::cout << "  └" << std::string(WIDTH, '─') << "┘\n";
-        std::cout << "  S = Start, L = Landing, * = Trajectory\n\n";
-        
-        std::cout << "  Scale: " << std::fixed << std::setprecision(1) 
-                  << maxX << " m horizontal, " << maxY << " m vertical\n\n";
-    }
-    
-    void showTrajectoryData() const {
-        std::cout << "📋 TRAJECTORY DATA (sample points):\n";
-        std::cout << std::string(50, '─') << "\n";
-        std::cout << std::setw(10) << "Time(s)" << std::setw(15) << "X(m)" 
-                  << std::setw(15) << "Y(m)" << "\n";
-        std::cout << std::string(50, '─') << "\n";
-        
-        float dt = data.airResistance ? 0.01f : 0.02f;
-        size_t step = trajectoryPoints.size() / 10;
-        if (step == 0) step = 1;
-        
-        for (size_t i = 0; i < trajectoryPoints.size(); i += step) {
-            float time = i * dt;
-            std::cout << std::fixed << std::setprecision(2)
-                      << std::setw(10) << time 
-                      << std::setw(15) << trajectoryPoints[i].x
-                      << std::setw(15) << trajectoryPoints[i].y << "\n";
-        }
-        std::cout << std::string(50, '─') << "\n\n";
-    }
-};
+#include <climits>
+#include <csignal>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
 
 void displayMenu() {
     std::cout << "\n╔════════════════════════════════════════╗\n";
@@ -240,16 +33,23 @@ void runSimulation() {
     std::cin >> airChoice;
     data.airResistance = (airChoice == 1);
     
+    if (data.airResistance) {
+        std::cout << "Integrator? (0=Euler, 1=Adaptive RK45): ";
+        int integratorChoice;
+        std::cin >> integratorChoice;
+        if (integratorChoice == 1) data.integrator = Integrator::DormandPrince;
+    }
+    
     ProjectileSimulator simulator(data);
     simulator.calculateTrajectory();
-    simulator.printResults();
-    simulator.visualizeTrajectory();
+    simulator.printResults(std::cout);
+    simulator.visualizeTrajectory(std::cout);
     
     std::cout << "Show detailed trajectory data? (1=Yes, 0=No): ";
     int showData;
     std::cin >> showData;
     if (showData == 1) {
-        simulator.showTrajectoryData();
+        simulator.showTrajectoryData(std::cout);
     }
 }
 
@@ -260,38 +60,47 @@ void compareAngles() {
     std::cin >> velocity;
     
     std::cout << "\nComparing angles from 15° to 75° (Earth gravity, no air resistance):\n\n";
-    std::cout << std::string(60, '─') << "\n";
+    std::cout << horizontalRule(60) << "\n";
     std::cout << std::setw(15) << "Angle" << std::setw(20) << "Range(m)" 
               << std::setw(20) << "Max Height(m)" << "\n";
-    std::cout << std::string(60, '─') << "\n";
-    
-    float bestAngle = 0;
-    float bestRange = 0;
+    std::cout << horizontalRule(60) << "\n";
     
+    ProjectileBatch batch;
     for (int angle = 15; angle <= 75; angle += 5) {
         ProjectileData data;
         data.initialVelocity = velocity;
         data.angle = angle;
         data.airResistance = false;
-        
-        ProjectileSimulator sim(data);
-        sim.calculateTrajectory();
-        
-        float range = sim.getRange();
-        if (range > bestRange) {
-            bestRange = range;
-            bestAngle = angle;
-        }
-        
-        std::cout << std::fixed << std::setprecision(2)
-                  << std::setw(15) << angle << "°"
-                  << std::setw(20) << range
-                  << std::setw(20) << sim.getMaxHeight() << "\n";
+        batch.add(data);
+    }
+    
+    BatchSimulator sim;
+    BatchResults results;
+    sim.run(batch, results);
+    
+    TextWriter rows(std::cout);
+    for (size_t i = 0; i < batch.size(); i++) {
+        rows.integer((int)batch.angle[i], 15).text("°")
+            .fixed(results.range[i], 2, 20)
+            .fixed(results.maxHeight[i], 2, 20).put('\n');
     }
+    rows.flush();
     
-    std::cout << std::string(60, '─') << "\n";
-    std::cout << "✨ Optimal angle: " << bestAngle << "° with range: " 
-              << bestRange << " m\n\n";
+    ProjectileData launch;
+    launch.initialVelocity = velocity;
+    launch.airResistance = false;
+    AngleSolution best = solveOptimalAngle(launch);
+    
+    // With drag the optimum drops below 45° and falls between grid rows
+    launch.airResistance = true;
+    AngleSolution bestWithDrag = solveOptimalAngle(launch);
+    
+    std::cout << horizontalRule(60) << "\n";
+    std::cout << std::fixed << std::setprecision(2)
+              << "✨ Optimal angle: " << best.angle << "° with range: " 
+              << best.metrics.range << " m\n";
+    std::cout << "   With air resistance: " << bestWithDrag.angle << "° with range: "
+              << bestWithDrag.metrics.range << " m\n\n";
 }
 
 void compareAirResistance() {
@@ -322,10 +131,10 @@ void compareAirResistance() {
     ProjectileSimulator sim2(data2);
     sim2.calculateTrajectory();
     
-    std::cout << "\n" << std::string(70, '─') << "\n";
+    std::cout << "\n" << horizontalRule(70) << "\n";
     std::cout << std::setw(30) << " " << std::setw(20) << "Without Air" 
               << std::setw(20) << "With Air" << "\n";
-    std::cout << std::string(70, '─') << "\n";
+    std::cout << horizontalRule(70) << "\n";
     
     std::cout << std::fixed << std::setprecision(2);
     std::cout << std::setw(30) << "Range (m):" 
@@ -340,11 +149,22 @@ void compareAirResistance() {
               << std::setw(20) << sim1.getFlightTime()
               << std::setw(20) << sim2.getFlightTime() << "\n";
     
-    std::cout << std::string(70, '─') << "\n";
+    std::cout << horizontalRule(70) << "\n";
     
     float rangeLoss = ((sim1.getRange() - sim2.getRange()) / sim1.getRange()) * 100;
     std::cout << "\n📉 Range reduction due to air resistance: " 
               << rangeLoss << "%\n\n";
+
+    // Both flights on one canvas, drawn to the larger extent
+    TrajectoryCanvas canvas;
+    canvas.include(sim1.getRange(), sim1.getMaxHeight());
+    canvas.include(sim2.getRange(), sim2.getMaxHeight());
+    canvas.plot(sim1.getTrajectoryPoints(), U'*');
+    canvas.plot(sim2.getTrajectoryPoints(), U'o');
+    canvas.addLegend(U'*', "Without air");
+    canvas.addLegend(U'o', "With air");
+    TextWriter out(std::cout, canvas.frameBytes(2) + 256);
+    canvas.render(out);
 }
 
 void testPlanets() {
@@ -357,47 +177,1046 @@ void testPlanets() {
     float angle;
     std::cin >> angle;
     
-    struct Planet {
-        std::string name;
-        float gravity;
-    };
-    
-    Planet planets[] = {
-        {"Earth", 9.8f},
-        {"Moon", 1.62f},
-        {"Mars", 3.71f},
-        {"Jupiter", 24.79f},
-        {"Venus", 8.87f}
-    };
+    const PresetRegistry& presets = PresetRegistry::shared();
     
-    std::cout << "\n" << std::string(75, '─') << "\n";
+    std::cout << "\n" << horizontalRule(75) << "\n";
     std::cout << std::setw(15) << "Planet" 
               << std::setw(15) << "Gravity(m/s²)"
               << std::setw(20) << "Range(m)" 
               << std::setw(20) << "Max Height(m)" << "\n";
-    std::cout << std::string(75, '─') << "\n";
+    std::cout << horizontalRule(75) << "\n";
     
-    for (const auto& planet : planets) {
+    // Every preset is one lane of a single batched sweep
+    ProjectileBatch batch;
+    for (PresetId id = 0; id < presets.size(); id++) {
         ProjectileData data;
         data.initialVelocity = velocity;
         data.angle = angle;
-        data.gravity = planet.gravity;
+        data.gravity = presets[id].gravity;
         data.airResistance = false;
-        
-        ProjectileSimulator sim(data);
-        sim.calculateTrajectory();
-        
-        std::cout << std::fixed << std::setprecision(2)
-                  << std::setw(15) << planet.name
-                  << std::setw(15) << planet.gravity
-                  << std::setw(20) << sim.getRange()
-                  << std::setw(20) << sim.getMaxHeight() << "\n";
+        batch.add(data);
+    }
+    
+    BatchSimulator sim;
+    BatchResults results;
+    sim.run(batch, results);
+    
+    TextWriter rows(std::cout);
+    for (size_t i = 0; i < batch.size(); i++) {
+        rows.text(presets[(PresetId)i].name, 15)
+            .fixed(presets[(PresetId)i].gravity, 2, 15)
+            .fixed(results.range[i], 2, 20)
+            .fixed(results.maxHeight[i], 2, 20).put('\n');
     }
+    rows.flush();
     
-    std::cout << std::string(75, '─') << "\n\n";
+    std::cout << horizontalRule(75) << "\n\n";
+}
+
+// Options for the non-interactive mode (any command-line argument enables it)
+struct CliOptions {
+    SweepGrid grid;
+    Integrator integrator;
+    float tolerance;
+    std::string inputPath;  // launch-spec file instead of the grid, "-" for stdin
+    std::string outputPath; // empty for stdout
+    std::string format;     // "table" or "csv"
+    bool trajectory;        // stream every state instead of a metrics row
+    bool plot;              // draw all launches on one text canvas instead
+    int plotWidth, plotHeight;
+    std::string binaryPath; // write trajectories to a binary trajectory file
+    TrajectoryEncoding encoding;
+    float simplify;         // drop states within this many meters of the kept path, negative for none
+    std::string inspectPath; // print the metrics stored in a binary trajectory file
+    unsigned threads;
+    size_t cacheSize;       // metrics cache entries, 0 disables the cache
+    float cacheStep;        // cache key quantization for all launch fields
+    bool optimizeAngle;     // replace each angle with the range-maximizing one
+    bool hasTarget;         // replace each angle with one that hits the target
+    float targetX, targetY;
+    bool highArc;
+    bool fastDrag;
+    FloatPrecision precision;
+    bool environment;       // 3D runs through wind and atmosphere models
+    float azimuth;
+    bool hasWind;
+    Vector3D wind;          // uniform wind, unless windPath is given
+    std::string windPath;   // gridded wind file
+    bool standardAtmosphere;
+    float groundAltitude;
+    std::string presetsPath; // preset file replacing the built-in planets
+    std::string planet;      // preset giving the gravity (and with --air, the atmosphere)
+    PresetId preset;
+    std::string serveAddress; // run as a simulation server instead
+    EnsembleSpec ensemble;  // perturbations around the single launch, count 0 for none
+    float velocitySigma, angleSigma, dragCoefficientSigma, massSigma; // normal about the launch
+    std::string backend;
+    SweepShard shard;       // count 0 unless --shard
+    std::string shardDir;
+    uint64_t reduceCount;   // shards to reduce, 0 for none
+
+    CliOptions() : integrator(Integrator::Euler), tolerance(ProjectileData().tolerance),
+                   format("table"), trajectory(false), plot(false),
+                   plotWidth(80), plotHeight(25), encoding(TrajectoryEncoding::Raw), simplify(-1),
+                   threads(0), cacheSize(0), cacheStep(0), optimizeAngle(false),
+                   hasTarget(false), targetX(0), targetY(0), highArc(false),
+                   fastDrag(false), precision(FloatPrecision::Single), environment(false), azimuth(0),
+                   hasWind(false), standardAtmosphere(false), groundAltitude(0),
+                   preset(PresetRegistry::NONE), velocitySigma(0), angleSigma(0),
+                   dragCoefficientSigma(0), massSigma(0), backend("cpu"), shard(0, 0), reduceCount(0) {}
+};
+
+void printUsage(std::ostream& out, const char* program) {
+    out << "usage: " << program << " [options]\n"
+        << "\n"
+        << "Runs launches without prompts and prints one result row per launch.\n"
+        << "Numeric launch options take a value or a first:last:count range; ranges\n"
+        << "are combined into a full grid.\n"
+        << "\n"
+        << "  --velocity V       initial velocity in m/s (default 50)\n"
+        << "  --angle A          launch angle in degrees (default 45)\n"
+        << "  --gravity G        gravity in m/s^2, > 0 (default 9.8)\n"
+        << "  --cd C             drag coefficient, >= 0 (default 0.47)\n"
+        << "  --mass M           mass in kg, > 0 (default 1)\n"
+        << "  --air              enable air resistance\n"
+        << "  --integrator I     euler or rk45 (with --air, default euler)\n"
+        << "  --tolerance T      rk45 error tolerance (default 1e-4)\n"
+        << "  --fast-drag        approximate 1/sqrt in the drag update (relative\n"
+        << "                     error below 5e-6 per step) for higher throughput\n"
+        << "  --precision P      drag integration arithmetic: single (default), double,\n"
+        << "                     or compensated (float with Kahan summation)\n"
+        << "  --input FILE       read launches from FILE (\"-\" for stdin), one per line:\n"
+        << "                     velocity angle [gravity [air 0/1 [cd [mass [integrator]]]]]\n"
+        << "                     (finite, gravity > 0, cd >= 0, mass > 0)\n"
+        << "  --output FILE      write results to FILE instead of stdout\n"
+        << "  --format F         table or csv (default table)\n"
+        << "  --trajectory       write every state (t,x,y,vx,vy) of each launch as CSV\n"
+        << "  --plot             draw every launch on one text plot instead of rows\n"
+        << "  --plot-size WxH    plot size in characters (default 80x25)\n"
+        << "  --azimuth A        launch heading in degrees toward +z (runs in 3D)\n"
+        << "  --wind U,V,W       uniform wind in m/s along x (downrange), y (up), z (runs in 3D)\n"
+        << "  --wind-file FILE   gridded wind, trilinearly interpolated (runs in 3D):\n"
+        << "                     nx ny nz, x0 y0 z0, dx dy dz, then u v w per node, x fastest\n"
+        << "  --atmosphere A     constant (sea-level density, default) or standard (ISA\n"
+        << "                     density by altitude; runs in 3D)\n"
+        << "  --altitude M       launch site altitude for --atmosphere standard\n"
+        << "  --planet NAME      take gravity from an environment preset (earth, moon, mars,\n"
+        << "                     jupiter, venus); with --air, also its exponential\n"
+        << "                     atmosphere (runs in 3D)\n"
+        << "  --presets FILE     preset file, one 'name gravity [density [scale_height]]'\n"
+        << "                     per line (default: $PROJECTILE_PRESETS or the planets above)\n"
+        << "  --binary FILE      write every trajectory to a binary trajectory file\n"
+        << "  --encoding E       raw, quantized or delta column encoding for --binary\n"
+        << "  --inspect FILE     print the launches stored in a binary trajectory file\n"
+        << "  --simplify TOL     with --trajectory or --binary, keep only the states needed\n"
+        << "                     to stay within TOL meters of every state of the path\n"
+        << "  --threads N        worker threads for the sweep, up to 1024 (default: all cores)\n"
+        << "  --serve ADDRESS    serve launches over a socket (PORT on loopback,\n"
+        << "                     HOST:PORT or unix:PATH): one launch per line in the\n"
+        << "                     --input format, one 'max_height range flight_time' reply\n"
+        << "                     per launch; concurrent requests are batched\n"
+        << "  --cache N          reuse the metrics of repeated launches (N entries);\n"
+        << "                     hit and miss counts are reported on stderr\n"
+        << "  --cache-step S     treat launch values within S/2 of each other as equal\n"
+        << "  --optimize-angle   solve for the angle of maximum range (ignores --angle)\n"
+        << "  --target X,Y       solve for the angle that passes through (X, Y)\n"
+        << "  --high-arc         with --target, take the steeper of the two solutions\n"
+        << "  --ensemble N       run N launches perturbed around the single launch given\n"
+        << "                     and print statistics and histograms of the results\n"
+        << "  --sigma-velocity S, --sigma-angle S, --sigma-cd S, --sigma-mass S\n"
+        << "                     normal perturbations about the launch's values\n"
+        << "  --dist-velocity D, --dist-angle D, --dist-cd D, --dist-mass D\n"
+        << "                     ensemble distributions, normal:MEAN,SD or uniform:LO,HI\n"
+        << "  --aim X            ensemble aim point for range miss distances\n"
+        << "                     and their range error probable (default: the launch's\n"
+        << "                     own impact)\n"
+        << "  --seed N           ensemble random seed (default 1)\n"
+        << "  --bins N           ensemble histogram bins (default 32)\n"
+        << "  --backend B        ensemble backend: cpu (default), or cuda in CUDA builds\n"
+        << "  --shard I/N        run only shard I of N of the launches or ensemble (launch\n"
+        << "                     k is in shard k mod N) and write its results to\n"
+        << "                     --shard-dir; a shard already complete there is skipped\n"
+        << "  --shard-dir DIR    directory shared by the --shard workers and --reduce\n"
+        << "  --reduce N         print the statistics of the N shards in --shard-dir, as\n"
+        << "                     for --ensemble (--aim default: the mean range)\n"
+        << "  --help             show this message\n";
+}
+
+// "value" or "first:last:count"
+bool parseAxis(const std::string& text, SweepAxis& axis) {
+    size_t first = text.find(':');
+    if (first == std::string::npos) {
+        float value;
+        if (!parseFloat(text, value)) return false;
+        axis = SweepAxis(value);
+        return true;
+    }
+
+    size_t second = text.find(':', first + 1);
+    if (second == std::string::npos) return false;
+
+    float from, to;
+    uint64_t count;
+    if (!parseFloat(text.substr(0, first), from) ||
+        !parseFloat(text.substr(first + 1, second - first - 1), to) ||
+        !parseCount(text.substr(second + 1), count) || count < 1 || count > INT_MAX) {
+        return false;
+    }
+    axis = SweepAxis(from, to, (int)count);
+    return true;
+}
+
+// Whether both ends of axis, and so every value between them, give a valid
+// launch (see launchValuesValid()) in place of field of the default launch
+bool axisValid(const SweepAxis& axis, float ProjectileData::*field) {
+    for (float value : {axis.first, axis.last}) {
+        ProjectileData data;
+        data.*field = value;
+        if (!launchValuesValid(data.initialVelocity, data.angle, data.gravity, data.dragCoefficient, data.mass)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parseEncoding(const std::string& text, TrajectoryEncoding& encoding) {
+    if (text == "raw") {
+        encoding = TrajectoryEncoding::Raw;
+    } else if (text == "quantized") {
+        encoding = TrajectoryEncoding::Quantized16;
+    } else if (text == "delta") {
+        encoding = TrajectoryEncoding::DeltaQuantized;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// "normal:MEAN,SD" or "uniform:LO,HI"
+bool parseDistribution(const std::string& text, ParameterDistribution& distribution) {
+    size_t colon = text.find(':');
+    size_t comma = text.find(',');
+    if (colon == std::string::npos || comma == std::string::npos || comma < colon) return false;
+
+    std::string kind = text.substr(0, colon);
+    float first, second;
+    if (!parseFloat(text.substr(colon + 1, comma - colon - 1), first) ||
+        !parseFloat(text.substr(comma + 1), second)) {
+        return false;
+    }
+    if (kind == "normal" && second >= 0) {
+        distribution = ParameterDistribution(ParameterDistribution::Normal, first, second);
+    } else if (kind == "uniform" && second >= first) {
+        distribution = ParameterDistribution(ParameterDistribution::Uniform, first, second);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parsePrecision(const std::string& text, FloatPrecision& precision) {
+    if (text == "single") {
+        precision = FloatPrecision::Single;
+    } else if (text == "double") {
+        precision = FloatPrecision::Double;
+    } else if (text == "compensated") {
+        precision = FloatPrecision::Compensated;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Returns false with a message in error when the arguments are invalid
+bool parseCliOptions(int argc, char** argv, CliOptions& options, std::string& error) {
+    bool gravityGiven = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        std::string value = hasValue ? argv[i + 1] : "";
+
+        SweepAxis* axis = nullptr;
+        float ProjectileData::*field = nullptr;
+        if (arg == "--velocity") {
+            axis = &options.grid.velocity;
+            field = &ProjectileData::initialVelocity;
+        } else if (arg == "--angle") {
+            axis = &options.grid.angle;
+            field = &ProjectileData::angle;
+        } else if (arg == "--gravity") {
+            axis = &options.grid.gravity;
+            field = &ProjectileData::gravity;
+        } else if (arg == "--cd") {
+            axis = &options.grid.dragCoefficient;
+            field = &ProjectileData::dragCoefficient;
+        }
+
+        if (axis) {
+            if (!hasValue || !parseAxis(value, *axis) || !axisValid(*axis, field)) {
+                error = "invalid value for " + arg + ": '" + value + "'";
+                return false;
+            }
+            gravityGiven = gravityGiven || axis == &options.grid.gravity;
+            i++;
+        } else if (arg == "--air") {
+            options.grid.airResistance = true;
+        } else if (arg == "--trajectory") {
+            options.trajectory = true;
+        } else if (arg == "--plot") {
+            options.plot = true;
+        } else if (arg == "--plot-size") {
+            size_t x = hasValue ? value.find('x') : std::string::npos;
+            uint64_t width = 0, height = 0;
+            if (x == std::string::npos || !parseCount(value.substr(0, x), width) ||
+                !parseCount(value.substr(x + 1), height) || width < 2 || height < 3 ||
+                width > 1000 || height > 1000) {
+                error = "invalid value for --plot-size: '" + value + "' (expected WxH)";
+                return false;
+            }
+            options.plotWidth = (int)width;
+            options.plotHeight = (int)height;
+            i++;
+        } else if (arg == "--optimize-angle") {
+            options.optimizeAngle = true;
+        } else if (arg == "--high-arc") {
+            options.highArc = true;
+        } else if (arg == "--fast-drag") {
+            options.fastDrag = true;
+        } else if (arg == "--target") {
+            size_t comma = value.find(',');
+            if (!hasValue || comma == std::string::npos ||
+                !parseFloat(value.substr(0, comma), options.targetX) ||
+                !parseFloat(value.substr(comma + 1), options.targetY)) {
+                error = "invalid value for --target: '" + value + "' (expected X,Y)";
+                return false;
+            }
+            options.hasTarget = true;
+            i++;
+        } else if (arg == "--mass" || arg == "--tolerance") {
+            float number;
+            if (!hasValue || !parseFloat(value, number) || !(number > 0) || !std::isfinite(number)) {
+                error = "invalid value for " + arg + ": '" + value + "'";
+                return false;
+            }
+            if (arg == "--mass") options.grid.mass = number;
+            else options.tolerance = number;
+            i++;
+        } else if (arg == "--integrator") {
+            if (!hasValue || !parseIntegrator(value, options.integrator)) {
+                error = "unknown integrator '" + value + "' (expected euler or rk45)";
+                return false;
+            }
+            i++;
+        } else if (arg == "--serve") {
+            if (!hasValue) {
+                error = "missing value for --serve";
+                return false;
+            }
+            options.serveAddress = value;
+            i++;
+        } else if (arg == "--planet" || arg == "--presets") {
+            if (!hasValue) {
+                error = "missing value for " + arg;
+                return false;
+            }
+            (arg == "--planet" ? options.planet : options.presetsPath) = value;
+            i++;
+        } else if (arg == "--precision") {
+            if (!hasValue || !parsePrecision(value, options.precision)) {
+                error = "unknown precision '" + value + "' (expected single, double or compensated)";
+                return false;
+            }
+            i++;
+        } else if (arg == "--encoding") {
+            if (!hasValue || !parseEncoding(value, options.encoding)) {
+                error = "unknown encoding '" + value + "' (expected raw, quantized or delta)";
+                return false;
+            }
+            i++;
+        } else if (arg == "--simplify") {
+            if (!hasValue || !parseFloat(value, options.simplify) || options.simplify < 0) {
+                error = "invalid value for --simplify: '" + value + "'";
+                return false;
+            }
+            i++;
+        } else if (arg == "--shard") {
+            size_t slash = hasValue ? value.find('/') : std::string::npos;
+            uint64_t index = 0, count = 0;
+            if (slash == std::string::npos || !parseCount(value.substr(0, slash), index) ||
+                !parseCount(value.substr(slash + 1), count) || count == 0 || index >= count) {
+                error = "invalid value for --shard: '" + value + "' (expected I/N with I < N)";
+                return false;
+            }
+            options.shard = SweepShard(index, count);
+            i++;
+        } else if (arg == "--reduce") {
+            if (!hasValue || !parseCount(value, options.reduceCount) || options.reduceCount == 0) {
+                error = "invalid value for --reduce: '" + value + "'";
+                return false;
+            }
+            i++;
+        } else if (arg == "--input" || arg == "--output" || arg == "--format" ||
+                   arg == "--binary" || arg == "--inspect" || arg == "--shard-dir") {
+            if (!hasValue) {
+                error = "missing value for " + arg;
+                return false;
+            }
+            if (arg == "--input") options.inputPath = value;
+            else if (arg == "--output") options.outputPath = value;
+            else if (arg == "--binary") options.binaryPath = value;
+            else if (arg == "--inspect") options.inspectPath = value;
+            else if (arg == "--shard-dir") options.shardDir = value;
+            else options.format = value;
+            i++;
+        } else if (arg == "--threads" || arg == "--cache") {
+            const uint64_t MAX_THREADS = 1024;
+            uint64_t number;
+            if (!hasValue || !parseCount(value, number) || (arg == "--threads" && number > MAX_THREADS) ||
+                number > SIZE_MAX) {
+                error = "invalid value for " + arg + ": '" + value + "'";
+                return false;
+            }
+            if (arg == "--threads") options.threads = (unsigned)number;
+            else options.cacheSize = (size_t)number;
+            i++;
+        } else if (arg == "--ensemble" || arg == "--seed" || arg == "--bins") {
+            uint64_t number;
+            if (!hasValue || !parseCount(value, number) || (arg == "--bins" && number == 0)) {
+                error = "invalid value for " + arg + ": '" + value + "'";
+                return false;
+            }
+            if (arg == "--ensemble") options.ensemble.count = number;
+            else if (arg == "--seed") options.ensemble.seed = number;
+            else options.ensemble.histogramBins = (size_t)number;
+            i++;
+        } else if (arg == "--sigma-velocity" || arg == "--sigma-angle" ||
+                   arg == "--sigma-cd" || arg == "--sigma-mass") {
+            float sigma;
+            if (!hasValue || !parseFloat(value, sigma) || sigma < 0) {
+                error = "invalid value for " + arg + ": '" + value + "'";
+                return false;
+            }
+            if (arg == "--sigma-velocity") options.velocitySigma = sigma;
+            else if (arg == "--sigma-angle") options.angleSigma = sigma;
+            else if (arg == "--sigma-cd") options.dragCoefficientSigma = sigma;
+            else options.massSigma = sigma;
+            i++;
+        } else if (arg == "--dist-velocity" || arg == "--dist-angle" ||
+                   arg == "--dist-cd" || arg == "--dist-mass") {
+            ParameterDistribution* distribution = &options.ensemble.mass;
+            if (arg == "--dist-velocity") distribution = &options.ensemble.velocity;
+            else if (arg == "--dist-angle") distribution = &options.ensemble.angle;
+            else if (arg == "--dist-cd") distribution = &options.ensemble.dragCoefficient;
+            if (!hasValue || !parseDistribution(value, *distribution)) {
+                error = "invalid value for " + arg + ": '" + value +
+                        "' (expected normal:MEAN,SD or uniform:LO,HI)";
+                return false;
+            }
+            i++;
+        } else if (arg == "--aim") {
+            if (!hasValue || !parseFloat(value, options.ensemble.aimPoint)) {
+                error = "invalid value for --aim: '" + value + "'";
+                return false;
+            }
+            options.ensemble.hasAimPoint = true;
+            i++;
+        } else if (arg == "--backend") {
+            if (!hasValue) {
+                error = "missing value for --backend";
+                return false;
+            }
+            options.backend = value;
+            i++;
+        } else if (arg == "--wind") {
+            size_t first = value.find(','), second = first == std::string::npos ? first : value.find(',', first + 1);
+            if (!hasValue || second == std::string::npos ||
+                !parseFloat(value.substr(0, first), options.wind.x) ||
+                !parseFloat(value.substr(first + 1, second - first - 1), options.wind.y) ||
+                !parseFloat(value.substr(second + 1), options.wind.z)) {
+                error = "invalid value for --wind: '" + value + "' (expected U,V,W)";
+                return false;
+            }
+            options.hasWind = options.environment = true;
+            i++;
+        } else if (arg == "--wind-file") {
+            if (!hasValue) {
+                error = "missing value for --wind-file";
+                return false;
+            }
+            options.windPath = value;
+            options.environment = true;
+            i++;
+        } else if (arg == "--atmosphere") {
+            if (!hasValue || (value != "standard" && value != "constant")) {
+                error = "unknown atmosphere '" + value + "' (expected standard or constant)";
+                return false;
+            }
+            options.standardAtmosphere = value == "standard";
+            options.environment = true;
+            i++;
+        } else if (arg == "--azimuth" || arg == "--altitude") {
+            float number;
+            if (!hasValue || !parseFloat(value, number)) {
+                error = "invalid value for " + arg + ": '" + value + "'";
+                return false;
+            }
+            if (arg == "--azimuth") options.azimuth = number;
+            else options.groundAltitude = number;
+            options.environment = true;
+            i++;
+        } else if (arg == "--cache-step") {
+            if (!hasValue || !parseFloat(value, options.cacheStep) || options.cacheStep < 0) {
+                error = "invalid value for --cache-step: '" + value + "'";
+                return false;
+            }
+            i++;
+        } else {
+            error = "unknown option '" + arg + "'";
+            return false;
+        }
+    }
+
+    if (options.optimizeAngle && options.hasTarget) {
+        error = "--optimize-angle and --target cannot be combined";
+        return false;
+    }
+    if (!options.presetsPath.empty() && !PresetRegistry::initialize(options.presetsPath, error)) {
+        return false;
+    }
+    if (!options.planet.empty()) {
+        const PresetRegistry& presets = PresetRegistry::shared();
+        options.preset = presets.find(options.planet);
+        if (options.preset == PresetRegistry::NONE) {
+            error = "unknown planet '" + options.planet + "'";
+            return false;
+        }
+        if (gravityGiven || options.standardAtmosphere) {
+            error = "--planet cannot be combined with --gravity or --atmosphere";
+            return false;
+        }
+        options.grid.gravity = SweepAxis(presets[options.preset].gravity);
+        if (options.grid.airResistance) options.environment = true;
+    }
+    if (options.environment && (options.trajectory || options.plot || !options.binaryPath.empty() ||
+                                !options.inspectPath.empty() || options.optimizeAngle || options.hasTarget ||
+                                options.ensemble.count > 0 || options.cacheSize > 0)) {
+        error = "--wind, --wind-file, --atmosphere, --azimuth, --altitude and --planet with --air "
+                "apply only to metrics runs";
+        return false;
+    }
+    // EnvironmentSimulator steps every launch with exact single-precision Euler
+    if (options.environment && (options.integrator != Integrator::Euler || options.fastDrag ||
+                                options.precision != FloatPrecision::Single)) {
+        error = "--wind, --wind-file, --atmosphere, --azimuth, --altitude and --planet with --air "
+                "integrate with exact-drag euler in single precision, so --integrator rk45, --precision "
+                "double|compensated and --fast-drag do not apply";
+        return false;
+    }
+    if (!options.serveAddress.empty() &&
+        (options.environment || options.trajectory || options.plot || !options.binaryPath.empty() ||
+         !options.inspectPath.empty() || !options.inputPath.empty() || options.optimizeAngle ||
+         options.hasTarget || options.ensemble.count > 0)) {
+        error = "--serve takes launches from its clients and cannot be combined with other modes";
+        return false;
+    }
+    if (options.simplify >= 0 && !options.trajectory && options.binaryPath.empty()) {
+        error = "--simplify applies only with --trajectory or --binary";
+        return false;
+    }
+    bool sharded = options.shard.count > 0, reducing = options.reduceCount > 0;
+    if (sharded && reducing) {
+        error = "--shard and --reduce cannot be combined";
+        return false;
+    }
+    if ((sharded || reducing) != !options.shardDir.empty()) {
+        error = options.shardDir.empty() ? "--shard and --reduce need --shard-dir"
+                                         : "--shard-dir applies only with --shard or --reduce";
+        return false;
+    }
+    if ((sharded || reducing) &&
+        (options.environment || options.trajectory || options.plot || !options.binaryPath.empty() ||
+         !options.inspectPath.empty() || options.optimizeAngle || options.hasTarget ||
+         !options.serveAddress.empty())) {
+        error = "--shard and --reduce apply only to metrics and ensemble runs";
+        return false;
+    }
+    if (sharded && !options.outputPath.empty()) {
+        error = "--shard writes its results to --shard-dir, not --output";
+        return false;
+    }
+    if (reducing && (!options.inputPath.empty() || options.ensemble.count > 0)) {
+        error = "--reduce takes its launches from the shard files";
+        return false;
+    }
+    if (options.hasWind && !options.windPath.empty()) {
+        error = "--wind and --wind-file cannot be combined";
+        return false;
+    }
+    if ((options.velocitySigma > 0 && options.ensemble.velocity.kind != ParameterDistribution::Fixed) ||
+        (options.angleSigma > 0 && options.ensemble.angle.kind != ParameterDistribution::Fixed) ||
+        (options.dragCoefficientSigma > 0 && options.ensemble.dragCoefficient.kind != ParameterDistribution::Fixed) ||
+        (options.massSigma > 0 && options.ensemble.mass.kind != ParameterDistribution::Fixed)) {
+        error = "a --sigma option and a --dist option cannot be given for the same parameter";
+        return false;
+    }
+    if (options.format != "table" && options.format != "csv") {
+        error = "unknown format '" + options.format + "' (expected table or csv)";
+        return false;
+    }
+    return true;
+}
+
+void writeMetrics(std::ostream& stream, const std::string& format,
+                  const ProjectileBatch& batch, const BatchResults& results) {
+    PROFILE_SCOPE("output.metrics");
+    TextWriter out(stream);
+    bool csv = format == "csv";
+    if (csv) {
+        out.text("velocity,angle,gravity,air,cd,mass,max_height,range,flight_time\n");
+    } else {
+        out.text("velocity", 10).text("angle", 10).text("gravity", 10).text("air", 5)
+           .text("cd", 8).text("mass", 8)
+           .text("max_height", 14).text("range", 14).text("flight_time", 14).put('\n');
+    }
+
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (csv) {
+            out.fixed(batch.initialVelocity[i], 2).put(',').fixed(batch.angle[i], 2).put(',')
+               .fixed(batch.gravity[i], 2).put(',').integer(batch.airResistance[i]).put(',')
+               .fixed(batch.dragCoefficient[i], 2).put(',').fixed(batch.mass[i], 2).put(',')
+               .fixed(results.maxHeight[i], 2).put(',').fixed(results.range[i], 2).put(',')
+               .fixed(results.flightTime[i], 2).put('\n');
+        } else {
+            out.fixed(batch.initialVelocity[i], 2, 10).fixed(batch.angle[i], 2, 10)
+               .fixed(batch.gravity[i], 2, 10).integer(batch.airResistance[i], 5)
+               .fixed(batch.dragCoefficient[i], 2, 8).fixed(batch.mass[i], 2, 8)
+               .fixed(results.maxHeight[i], 2, 14).fixed(results.range[i], 2, 14)
+               .fixed(results.flightTime[i], 2, 14).put('\n');
+        }
+    }
+}
+
+// Like writeMetrics() for 3D runs, with the azimuth and the crossrange drift
+void writeEnvironmentMetrics(std::ostream& stream, const std::string& format,
+                             const ProjectileBatch& batch, const EnvironmentResults& results) {
+    PROFILE_SCOPE("output.metrics");
+    TextWriter out(stream);
+    bool csv = format == "csv";
+    if (csv) {
+        out.text("velocity,angle,azimuth,gravity,air,cd,mass,max_height,range,drift,flight_time\n");
+    } else {
+        out.text("velocity", 10).text("angle", 10).text("azimuth", 10).text("gravity", 10).text("air", 5)
+           .text("cd", 8).text("mass", 8)
+           .text("max_height", 14).text("range", 14).text("drift", 14).text("flight_time", 14).put('\n');
+    }
+
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (csv) {
+            out.fixed(batch.initialVelocity[i], 2).put(',').fixed(batch.angle[i], 2).put(',')
+               .fixed(batch.azimuth[i], 2).put(',')
+               .fixed(batch.gravity[i], 2).put(',').integer(batch.airResistance[i]).put(',')
+               .fixed(batch.dragCoefficient[i], 2).put(',').fixed(batch.mass[i], 2).put(',')
+               .fixed(results.maxHeight[i], 2).put(',').fixed(results.range[i], 2).put(',')
+               .fixed(results.drift[i], 2).put(',').fixed(results.flightTime[i], 2).put('\n');
+        } else {
+            out.fixed(batch.initialVelocity[i], 2, 10).fixed(batch.angle[i], 2, 10)
+               .fixed(batch.azimuth[i], 2, 10)
+               .fixed(batch.gravity[i], 2, 10).integer(batch.airResistance[i], 5)
+               .fixed(batch.dragCoefficient[i], 2, 8).fixed(batch.mass[i], 2, 8)
+               .fixed(results.maxHeight[i], 2, 14).fixed(results.range[i], 2, 14)
+               .fixed(results.drift[i], 2, 14).fixed(results.flightTime[i], 2, 14).put('\n');
+        }
+    }
+}
+
+// Statistics of each metric, the impact dispersion, then the histogram bins
+// of each metric
+void writeEnsemble(std::ostream& stream, const std::string& format, const EnsembleSummary& summary) {
+    PROFILE_SCOPE("output.ensemble");
+    const char* names[] = {"max_height", "range", "flight_time", "miss_distance"};
+    const EnsembleMetric* metrics[] = {&summary.maxHeight, &summary.range, &summary.flightTime, &summary.miss};
+
+    TextWriter out(stream);
+    bool csv = format == "csv";
+    if (csv) {
+        out.text("metric,count,mean,stddev,min,max,outside_bins\n");
+    } else {
+        out.text("metric", 14).text("count", 12).text("mean", 14).text("stddev", 14)
+           .text("min", 14).text("max", 14).text("outside_bins", 14).put('\n');
+    }
+    for (int m = 0; m < 4; m++) {
+        const RunningStatistics& st = metrics[m]->statistics;
+        long long outside = (long long)(metrics[m]->histogram.underflow + metrics[m]->histogram.overflow);
+        if (csv) {
+            out.text(names[m]).put(',').integer((long long)st.count).put(',')
+               .fixed((float)st.mean, 4).put(',').fixed((float)st.standardDeviation(), 4).put(',')
+               .fixed(st.min, 4).put(',').fixed(st.max, 4).put(',').integer(outside).put('\n');
+        } else {
+            out.text(names[m], 14).integer((long long)st.count, 12)
+               .fixed((float)st.mean, 4, 14).fixed((float)st.standardDeviation(), 4, 14)
+               .fixed(st.min, 4, 14).fixed(st.max, 4, 14).integer(outside, 14).put('\n');
+        }
+    }
+
+    float meanImpact = (float)summary.range.statistics.mean;
+    float impact[] = {summary.aimPoint, meanImpact, meanImpact - summary.aimPoint,
+                      summary.rangeError(0.5), summary.rangeError(0.9)};
+    out.put('\n');
+    if (csv) {
+        out.text("aim_point,mean_impact,bias,rep50,rep90\n");
+        for (int k = 0; k < 5; k++) out.fixed(impact[k], 4).put(k < 4 ? ',' : '\n');
+    } else {
+        out.text("aim_point", 14).text("mean_impact", 14).text("bias", 14)
+           .text("rep50", 14).text("rep90", 14).put('\n');
+        for (int k = 0; k < 5; k++) out.fixed(impact[k], 4, 14);
+        out.put('\n');
+    }
+
+    out.put('\n');
+    if (csv) {
+        out.text("metric,bin_start,bin_end,count\n");
+    } else {
+        out.text("metric", 14).text("bin_start", 14).text("bin_end", 14).text("count", 12).put('\n');
+    }
+    for (int m = 0; m < 3; m++) {
+        const Histogram& h = metrics[m]->histogram;
+        for (size_t b = 0; b < h.bins.size(); b++) {
+            float start = h.binStart(b), end = h.binStart(b + 1);
+            if (csv) {
+                out.text(names[m]).put(',').fixed(start, 4).put(',').fixed(end, 4).put(',')
+                   .integer((long long)h.bins[b]).put('\n');
+            } else {
+                out.text(names[m], 14).fixed(start, 4, 14).fixed(end, 4, 14)
+                   .integer((long long)h.bins[b], 12).put('\n');
+            }
+        }
+    }
+}
+
+#if !defined(_WIN32)
+SimulationServer* activeServer = nullptr;
+
+void stopActiveServer(int) {
+    if (activeServer) activeServer->stop();
 }
+#endif
 
-int main() {
+// The --ensemble launches about nominal, with the --sigma options applied
+EnsembleSpec ensembleFor(const CliOptions& options, const ProjectileData& nominal) {
+    EnsembleSpec spec = options.ensemble;
+    spec.nominal = nominal;
+    const ParameterDistribution::Kind normal = ParameterDistribution::Normal;
+    if (options.velocitySigma > 0) {
+        spec.velocity = ParameterDistribution(normal, nominal.initialVelocity, options.velocitySigma);
+    }
+    if (options.angleSigma > 0) {
+        spec.angle = ParameterDistribution(normal, nominal.angle, options.angleSigma);
+    }
+    if (options.dragCoefficientSigma > 0) {
+        spec.dragCoefficient = ParameterDistribution(normal, nominal.dragCoefficient,
+                                                     options.dragCoefficientSigma);
+    }
+    if (options.massSigma > 0) {
+        spec.mass = ParameterDistribution(normal, nominal.mass, options.massSigma);
+    }
+    return spec;
+}
+
+// Entry point for scripted use: no prompts or banners, and box drawing
+// only in --plot output
+int runHeadless(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--help") {
+            printUsage(std::cout, argv[0]);
+            return 0;
+        }
+    }
+
+    CliOptions options;
+    std::string error;
+    if (!parseCliOptions(argc, argv, options, error)) {
+        std::cerr << argv[0] << ": " << error << "\n"
+                  << "Try '" << argv[0] << " --help' for more information.\n";
+        return 2;
+    }
+
+    std::ios::sync_with_stdio(false);
+
+    if (!options.serveAddress.empty()) {
+#if !defined(_WIN32)
+        SimulationServer server(options.threads);
+        if (!server.listen(options.serveAddress, error)) {
+            std::cerr << argv[0] << ": " << error << "\n";
+            return 1;
+        }
+        std::cerr << argv[0] << ": serving on " << options.serveAddress;
+        if (server.port()) std::cerr << " (port " << server.port() << ")";
+        std::cerr << std::endl;
+
+        activeServer = &server;
+        signal(SIGINT, stopActiveServer);
+        signal(SIGTERM, stopActiveServer);
+        server.run();
+        activeServer = nullptr;
+        std::cerr << argv[0] << ": served " << server.requests() << " requests in "
+                  << server.batches() << " batches\n";
+        return 0;
+#else
+        std::cerr << argv[0] << ": --serve is not supported on this platform\n";
+        return 1;
+#endif
+    }
+
+    ProjectileBatch batch;
+    BatchResults stored;
+    bool sharded = false;
+    if (!options.inspectPath.empty()) {
+        TrajectoryFileReader reader;
+        if (!reader.open(options.inspectPath, error)) {
+            std::cerr << argv[0] << ": " << options.inspectPath << ": " << error << "\n";
+            return 1;
+        }
+        stored.resize(reader.launchCount());
+        for (size_t i = 0; i < reader.launchCount(); i++) {
+            const TrajectoryFileRecord& r = reader.record(i);
+            batch.add(r.launch());
+            stored.maxHeight[i] = r.maxHeight;
+            stored.range[i] = r.range;
+            stored.flightTime[i] = r.flightTime;
+        }
+    } else if (!options.inputPath.empty()) {
+        std::ifstream file;
+        if (options.inputPath != "-") {
+            file.open(options.inputPath);
+            if (!file) {
+                std::cerr << argv[0] << ": cannot open input file '" << options.inputPath << "'\n";
+                return 1;
+            }
+        }
+        std::istream& in = options.inputPath == "-" ? std::cin : file;
+        if (!loadLaunchFile(in, batch, error)) {
+            std::cerr << argv[0] << ": " << options.inputPath << ": " << error << "\n";
+            return 1;
+        }
+    } else {
+        // A shard of a grid sweep builds only its own launches
+        sharded = options.shard.count > 0 && options.ensemble.count == 0;
+        batch = sharded ? selectShard(options.grid, options.shard) : options.grid.build();
+        for (size_t i = 0; i < batch.size(); i++) {
+            batch.integrator[i] = options.integrator;
+            batch.tolerance[i] = options.tolerance;
+            batch.fastDrag[i] = options.fastDrag ? 1 : 0;
+            batch.precision[i] = options.precision;
+            batch.azimuth[i] = options.azimuth;
+        }
+    }
+
+    std::ofstream file;
+    if (!options.outputPath.empty()) {
+        file.open(options.outputPath);
+        if (!file) {
+            std::cerr << argv[0] << ": cannot open output file '" << options.outputPath << "'\n";
+            return 1;
+        }
+    }
+    std::ostream& out = options.outputPath.empty() ? std::cout : file;
+
+    if (options.ensemble.count > 0 && batch.size() != 1) {
+        std::cerr << argv[0] << ": --ensemble needs exactly one nominal launch, got "
+                  << batch.size() << "\n";
+        return 2;
+    }
+
+    if (options.shard.count > 0) {
+        SweepShard shard = options.shard;
+        ProjectileBatch launches;
+        if (sharded) {
+            ProjectileData settings;
+            settings.integrator = options.integrator;
+            settings.tolerance = options.tolerance;
+            settings.fastDrag = options.fastDrag;
+            settings.precision = options.precision;
+            settings.azimuth = options.azimuth;
+            shard.fingerprint = sweepFingerprint(options.grid, settings, shard.count);
+            launches = std::move(batch);
+        } else if (options.ensemble.count > 0) {
+            EnsembleSpec spec = ensembleFor(options, batch.get(0));
+            shard.fingerprint = sweepFingerprint(spec, shard.count);
+            launches = selectShard(spec, shard);
+        } else {
+            shard.fingerprint = sweepFingerprint(batch, shard.count);
+            launches = selectShard(batch, shard);
+        }
+        std::string path = shard.path(options.shardDir);
+        if (shardComplete(options.shardDir, shard, launches)) {
+            std::cerr << argv[0] << ": " << path << " is already complete\n";
+            return 0;
+        }
+        SweepRunner runner(options.threads);
+        if (!runShard(options.shardDir, shard, launches, runner, error)) {
+            std::cerr << argv[0] << ": " << error << "\n";
+            return 1;
+        }
+        std::cerr << argv[0] << ": wrote " << launches.size() << " launches to " << path << "\n";
+        return 0;
+    }
+
+    if (options.reduceCount > 0) {
+        EnsembleSummary summary;
+        const float* aim = options.ensemble.hasAimPoint ? &options.ensemble.aimPoint : nullptr;
+        if (!reduceShards(options.shardDir, options.reduceCount, options.ensemble.histogramBins, aim,
+                          summary, error)) {
+            std::cerr << argv[0] << ": " << options.shardDir << ": " << error << "\n";
+            return 1;
+        }
+        writeEnsemble(out, options.format, summary);
+    } else if (options.ensemble.count > 0) {
+        std::unique_ptr<EnsembleBackend> backend = makeEnsembleBackend(options.backend, options.threads, error);
+        if (!backend) {
+            std::cerr << argv[0] << ": " << error << "\n";
+            return 2;
+        }
+        writeEnsemble(out, options.format, backend->run(ensembleFor(options, batch.get(0))));
+    } else if (!options.inspectPath.empty()) {
+        writeMetrics(out, options.format, batch, stored);
+    } else if (!options.binaryPath.empty()) {
+        TrajectoryFileWriter writer;
+        if (!writer.open(options.binaryPath, options.encoding)) {
+            std::cerr << argv[0] << ": cannot open binary file '" << options.binaryPath << "'\n";
+            return 1;
+        }
+        SimplifyingSink simplifier(writer, options.simplify);
+        TrajectorySink& sink = options.simplify >= 0 ? (TrajectorySink&)simplifier : writer;
+        for (size_t i = 0; i < batch.size(); i++) {
+            ProjectileSimulator(batch.get(i)).simulate(sink);
+        }
+        if (!writer.close()) {
+            std::cerr << argv[0] << ": error writing '" << options.binaryPath << "'\n";
+            return 1;
+        }
+    } else if (options.trajectory) {
+        CsvTrajectoryWriter writer(out);
+        SimplifyingSink simplifier(writer, options.simplify);
+        TrajectorySink& sink = options.simplify >= 0 ? (TrajectorySink&)simplifier : writer;
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (i > 0) out << '\n';
+            ProjectileSimulator(batch.get(i)).simulate(sink);
+        }
+    } else if (options.plot) {
+        // Extents come from a metrics pass; the launches are then streamed
+        // onto the canvas, so no trajectory is stored
+        BatchResults results;
+        SweepRunner(options.threads).run(batch, results);
+        TrajectoryCanvas canvas(options.plotWidth, options.plotHeight);
+        for (size_t i = 0; i < batch.size(); i++) canvas.include(results.range[i], results.maxHeight[i]);
+
+        const char marks[] = "*o+x#@%&";
+        const size_t markCount = sizeof(marks) - 1;
+        CanvasSink sink(canvas, U'*');
+        for (size_t i = 0; i < batch.size(); i++) {
+            sink.setMark((char32_t)marks[i % markCount]);
+            ProjectileSimulator(batch.get(i)).simulate(sink);
+            if (batch.size() <= markCount) {
+                char label[64];
+                std::snprintf(label, sizeof(label), "%.1f m/s at %.1f°", batch.initialVelocity[i], batch.angle[i]);
+                canvas.addLegend((char32_t)marks[i], label);
+            }
+        }
+
+        TextWriter writer(out, canvas.frameBytes(2) + 1024);
+        canvas.render(writer);
+        writer.text("  Scale: ").fixed(canvas.extentX(), 1).text(" m horizontal, ")
+              .fixed(canvas.extentY(), 1).text(" m vertical\n");
+    } else if (options.environment) {
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (batch.airResistance[i] && batch.integrator[i] != Integrator::Euler) {
+                std::cerr << argv[0] << ": " << options.inputPath << ": launch " << i + 1
+                          << " asks for rk45, but 3D runs integrate with euler only\n";
+                return 1;
+            }
+        }
+        std::unique_ptr<GriddedWind> wind;
+        if (!options.windPath.empty()) {
+            std::ifstream windFile(options.windPath);
+            if (!windFile) {
+                std::cerr << argv[0] << ": cannot open wind file '" << options.windPath << "'\n";
+                return 1;
+            }
+            if (!GriddedWind::load(windFile, wind, error)) {
+                std::cerr << argv[0] << ": " << options.windPath << ": " << error << "\n";
+                return 1;
+            }
+        } else if (options.hasWind) {
+            wind.reset(new GriddedWind(GriddedWind::uniform(options.wind)));
+        }
+        Environment environment;
+        environment.wind = wind.get();
+        if (options.preset != PresetRegistry::NONE) {
+            environment.atmosphere = &PresetRegistry::shared().atmosphere(options.preset);
+        } else if (options.standardAtmosphere) {
+            environment.atmosphere = &TabulatedAtmosphere::standard();
+        }
+        environment.groundAltitude = options.groundAltitude;
+
+        EnvironmentResults results;
+        SweepRunner(options.threads).run(batch, environment, results);
+        writeEnvironmentMetrics(out, options.format, batch, results);
+    } else if (options.optimizeAngle || options.hasTarget) {
+        // Launches the solver cannot satisfy are reported with a nan angle
+        BatchResults results;
+        results.resize(batch.size());
+        size_t unreachable = 0;
+        for (size_t i = 0; i < batch.size(); i++) {
+            AngleSolution solution = options.optimizeAngle
+                ? solveOptimalAngle(batch.get(i))
+                : solveAngleForTarget(batch.get(i), options.targetX, options.targetY, options.highArc);
+            if (!solution.found) {
+                solution.angle = NAN;
+                solution.metrics.maxHeight = solution.metrics.range = solution.metrics.flightTime = NAN;
+                unreachable++;
+            }
+            batch.angle[i] = solution.angle;
+            results.maxHeight[i] = solution.metrics.maxHeight;
+            results.range[i] = solution.metrics.range;
+            results.flightTime[i] = solution.metrics.flightTime;
+        }
+        writeMetrics(out, options.format, batch, results);
+        if (unreachable) std::cerr << argv[0] << ": " << unreachable << " launches have no solution\n";
+    } else {
+        SweepRunner runner(options.threads);
+        BatchResults results;
+        if (options.cacheSize > 0) {
+            CacheQuantization step;
+            step.initialVelocity = step.angle = step.gravity = options.cacheStep;
+            step.dragCoefficient = step.mass = options.cacheStep;
+            MetricsCache cache(options.cacheSize, step);
+            runner.setCache(&cache);
+            runner.run(batch, results);
+            runner.setCache(nullptr);
+            std::cerr << "cache: " << cache.hits() << " hits, " << cache.misses() << " misses\n";
+        } else {
+            runner.run(batch, results);
+        }
+        writeMetrics(out, options.format, batch, results);
+    }
+
+    out.flush();
+    if (!out) {
+        std::cerr << argv[0] << ": error writing results\n";
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::string error;
+    if (!PresetRegistry::initializeFromEnvironment(error)) {
+        std::cerr << "warning: " << error << "; using the built-in presets\n";
+    }
+    if (argc > 1) {
+        return runHeadless(argc, argv);
+    }
+    
     std::cout << R"(
     ╔═══════════════════════════════════════════════════════╗
     ║                                                       ║
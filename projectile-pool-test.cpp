@@ -0,0 +1,71 @@
+// Checks WorkStealingPool::parallelFor: every index is covered once, an
+// exception thrown by a chunk on the calling thread or on a worker is
+// rethrown to the caller after the other chunks have run, and the pool
+// stays usable afterwards.
+
+#include "projectile-core.h"
+#include "projectile-test.h"
+
+#include <stdexcept>
+
+static const size_t COUNT = 10000;
+static const size_t CHUNK = 16;
+static const size_t CHUNKS = COUNT / CHUNK;
+
+struct Outcome {
+    bool threw;
+    bool anyFailed;
+    bool othersRanOnce; // every index of a chunk that did not throw ran once
+};
+
+// Runs a parallelFor whose chunks throw when fails(begin) says so
+static Outcome runSweep(WorkStealingPool& pool, const std::function<bool(size_t)>& fails) {
+    std::vector<std::atomic<int>> visits(COUNT);
+    std::vector<std::atomic<bool>> failed(CHUNKS);
+    for (auto& visit : visits) visit = 0;
+    for (auto& chunk : failed) chunk = false;
+
+    Outcome outcome = {false, false, true};
+    try {
+        pool.parallelFor(COUNT, CHUNK, [&](unsigned, size_t begin, size_t end) {
+            if (fails(begin)) {
+                failed[begin / CHUNK] = true;
+                throw std::runtime_error("chunk failed");
+            }
+            for (size_t i = begin; i < end; i++) visits[i]++;
+        });
+    } catch (const std::runtime_error&) {
+        outcome.threw = true;
+    }
+    for (size_t i = 0; i < COUNT; i++) {
+        bool chunkFailed = failed[i / CHUNK];
+        outcome.anyFailed = outcome.anyFailed || chunkFailed;
+        if (visits[i] != (chunkFailed ? 0 : 1)) outcome.othersRanOnce = false;
+    }
+    return outcome;
+}
+
+int main() {
+    WorkStealingPool pool(4);
+    std::thread::id caller = std::this_thread::get_id();
+
+    Outcome clean = runSweep(pool, [](size_t) { return false; });
+    check(!clean.threw && clean.othersRanOnce, "every index runs exactly once");
+
+    Outcome onCaller = runSweep(pool, [&](size_t) { return std::this_thread::get_id() == caller; });
+    check(onCaller.threw == onCaller.anyFailed, "a chunk that throws on the calling thread is rethrown");
+    check(onCaller.othersRanOnce, "the other chunks run after a chunk throws on the calling thread");
+
+    Outcome onWorkers = runSweep(pool, [&](size_t begin) {
+        return std::this_thread::get_id() != caller && begin % (7 * CHUNK) == 0;
+    });
+    check(onWorkers.threw == onWorkers.anyFailed, "a chunk that throws on a worker is rethrown to the caller");
+    check(onWorkers.othersRanOnce, "the other chunks run after a chunk throws on a worker");
+
+    Outcome everywhere = runSweep(pool, [](size_t) { return true; });
+    check(everywhere.threw, "a sweep where every chunk throws is rethrown");
+
+    Outcome after = runSweep(pool, [](size_t) { return false; });
+    check(!after.threw && after.othersRanOnce, "the pool is usable after a failure");
+    return report("pool");
+}
@@ -0,0 +1,63 @@
+// Checks that ProjectileSimulator::resimulateFrom() matches a fresh run
+// with the same change point for point, over a sweep of launches, change
+// times, tolerances, integrators and precisions, for a first change and for
+// a second, earlier one.
+
+#include "projectile-core.h"
+#include "projectile-test.h"
+
+static bool sameTrajectory(const ProjectileSimulator& a, const ProjectileSimulator& b) {
+    const std::vector<Vector2D>& p = a.getTrajectoryPoints();
+    const std::vector<Vector2D>& q = b.getTrajectoryPoints();
+    if (p.size() != q.size()) return false;
+    for (size_t i = 0; i < p.size(); i++) {
+        if (p[i].x != q[i].x || p[i].y != q[i].y) return false;
+    }
+    return a.getRange() == b.getRange() && a.getFlightTime() == b.getFlightTime() &&
+           a.getMaxHeight() == b.getMaxHeight();
+}
+
+int main() {
+    const float velocities[] = {5, 20, 50, 120, 300};
+    const float angles[] = {10, 35, 60, 78, 85};
+    const float tolerances[] = {1e-3f, 1e-4f, 1e-6f};
+    const float fractions[] = {0.1f, 0.25f, 0.5f, 0.75f, 0.9f};
+    const Integrator integrators[] = {Integrator::Euler, Integrator::DormandPrince};
+    const FloatPrecision precisions[] = {FloatPrecision::Single, FloatPrecision::Compensated};
+
+    int differing = 0;
+    for (float velocity : velocities)
+    for (float angle : angles)
+    for (float tolerance : tolerances)
+    for (Integrator integrator : integrators)
+    for (FloatPrecision precision : precisions)
+    for (float fraction : fractions) {
+        if (integrator == Integrator::Euler && tolerance != tolerances[0]) continue;
+        ProjectileData data;
+        data.initialVelocity = velocity;
+        data.angle = angle;
+        data.airResistance = true;
+        data.tolerance = tolerance;
+        data.integrator = integrator;
+        data.precision = precision;
+
+        ProjectileSimulator resumed(data);
+        resumed.calculateTrajectory();
+        float flightTime = resumed.getFlightTime();
+        ParameterChange first = {fraction * flightTime, 0.9f, 2.0f};
+        ParameterChange second = {0.6f * fraction * flightTime, 0.3f, 1.5f};
+
+        resumed.resimulateFrom(first);
+        ProjectileSimulator fresh(data);
+        fresh.resimulateFrom(first);
+        if (!sameTrajectory(resumed, fresh)) differing++;
+
+        resumed.resimulateFrom(second);
+        ProjectileSimulator freshSecond(data);
+        freshSecond.resimulateFrom(second);
+        if (!sameTrajectory(resumed, freshSecond)) differing++;
+    }
+    if (differing) std::cerr << differing << " resumed runs differ from a fresh run\n";
+    check(differing == 0, "resumed runs match fresh runs with the same change");
+    return report("resume");
+}
@@ -0,0 +1,94 @@
+// Checks SimulationServer replies over a loopback socket: valid launches get
+// finite metrics, and launches the parser rejects (zero or negative mass,
+// zero gravity, non-finite values) get an error line instead of nan or
+// step-cap results.
+
+#include "projectile-core.h"
+#include "projectile-test.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <sstream>
+
+// Sends request to the server on port, closes the sending side and returns
+// the reply lines
+static std::vector<std::string> exchange(int port, const std::string& request) {
+    std::vector<std::string> lines;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t)port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, (const sockaddr*)&address, sizeof(address)) != 0) {
+        if (fd >= 0) close(fd);
+        return lines;
+    }
+
+    for (size_t sent = 0; sent < request.size(); ) {
+        ssize_t n = write(fd, request.data() + sent, request.size() - sent);
+        if (n <= 0) break;
+        sent += (size_t)n;
+    }
+    shutdown(fd, SHUT_WR);
+
+    std::string reply;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) reply.append(buffer, (size_t)n);
+    close(fd);
+
+    std::istringstream in(reply);
+    std::string line;
+    while (std::getline(in, line)) lines.push_back(line);
+    return lines;
+}
+
+static bool isError(const std::string& line) { return line.compare(0, 7, "error: ") == 0; }
+
+// Three finite numbers, the flight time below the Euler step cap
+static bool isResult(const std::string& line) {
+    std::istringstream in(line);
+    float maxHeight, range, flightTime;
+    std::string rest;
+    return (bool)(in >> maxHeight >> range >> flightTime) && !(in >> rest) &&
+           std::isfinite(maxHeight) && std::isfinite(range) && std::isfinite(flightTime) &&
+           flightTime < MAX_NUMERICAL_STEPS * NUMERICAL_DT;
+}
+
+int main() {
+    SimulationServer server(2);
+    std::string error;
+    if (!server.listen("0", error)) {
+        std::cerr << "cannot listen: " << error << "\n";
+        return 1;
+    }
+    std::thread serving([&] { server.run(); });
+
+    std::vector<std::string> replies = exchange(server.port(),
+        "50 45 9.8 1 0.47 1\n"       // valid drag launch
+        "50 45 9.8 1 0.47 0\n"       // zero mass: -nan range
+        "50 45 9.8 1 0.47 -1 rk45\n" // negative mass: negative drag
+        "50 45 0 1\n"                // zero gravity: runs to the step cap
+        "nan 45\n"
+        "50 45 9.8 0 -1\n"           // negative cd
+        "# comment\n"
+        "30 60\n");                  // valid drag-free launch
+
+    server.stop();
+    serving.join();
+
+    check(replies.size() == 7, "one reply per launch line");
+    if (replies.size() == 7) {
+        check(isResult(replies[0]), "a valid drag launch gets finite metrics");
+        check(isError(replies[1]), "zero mass is rejected");
+        check(isError(replies[2]), "negative mass is rejected");
+        check(isError(replies[3]), "zero gravity is rejected instead of running to the step cap");
+        check(isError(replies[4]), "a nan velocity is rejected");
+        check(isError(replies[5]), "a negative drag coefficient is rejected");
+        check(isResult(replies[6]), "a valid drag-free launch gets finite metrics");
+    }
+    return report("server");
+}
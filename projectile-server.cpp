@@ -0,0 +1,308 @@
+// SimulationServer (see projectile-core.h): the sockets, poll loop and
+// request parsing, kept out of the public header with the POSIX includes
+#include "projectile-core.h"
+
+#if !defined(_WIN32)
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <csignal>
+
+struct SimulationServer::Impl {
+    static constexpr size_t INPUT_LIMIT = 1 << 20;  // stop reading a client this far ahead
+    static constexpr size_t OUTPUT_LIMIT = 4 << 20; // stop serving a client that does not read
+
+    struct Connection {
+        int fd;
+        std::string input, output;
+        size_t scanned; // input bytes already known to hold no newline
+        bool eof, failed;
+
+        explicit Connection(int fd) : fd(fd), scanned(0), eof(false), failed(false) {}
+    };
+
+    // A request line in arrival order; launch is -1 for a malformed line
+    struct Request {
+        Connection* connection;
+        long launch;
+    };
+
+    int listener;
+    int wake[2];
+    std::string unixPath;
+    std::vector<std::unique_ptr<Connection>> connections;
+    SweepRunner runner;
+    size_t maxBatch;
+    size_t first;  // connection served first, rotated for fairness
+    std::atomic<bool> stopping;
+    uint64_t requestCount, batchCount;
+
+    static bool setNonBlocking(int fd) {
+        int flags = fcntl(fd, F_GETFL, 0);
+        return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+    }
+
+    static bool readable(const Connection& c) {
+        return !c.eof && !c.failed && c.input.size() < INPUT_LIMIT;
+    }
+
+    static bool hasLine(Connection& c) {
+        if (c.input.find('\n', c.scanned) == std::string::npos) {
+            c.scanned = c.input.size();
+            return false;
+        }
+        return !c.failed && c.output.size() < OUTPUT_LIMIT;
+    }
+
+    void accept() {
+        for (;;) {
+            int fd = ::accept(listener, nullptr, nullptr);
+            if (fd < 0) return;
+            if (!setNonBlocking(fd)) {
+                ::close(fd);
+                continue;
+            }
+            connections.emplace_back(new Connection(fd));
+        }
+    }
+
+    static void receive(Connection& c) {
+        char buffer[65536];
+        while (readable(c)) {
+            ssize_t n = ::read(c.fd, buffer, sizeof(buffer));
+            if (n > 0) {
+                c.input.append(buffer, (size_t)n);
+            } else if (n == 0) {
+                // A last line without a newline is still a request
+                c.eof = true;
+                if (!c.input.empty() && c.input.back() != '\n') c.input += '\n';
+            } else {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) c.failed = true;
+                if (errno != EINTR) break;
+            }
+        }
+        if (c.input.size() >= INPUT_LIMIT && c.input.find('\n', c.scanned) == std::string::npos) {
+            c.failed = true; // a line longer than INPUT_LIMIT
+        }
+    }
+
+    static void send(Connection& c) {
+        size_t sent = 0;
+        while (sent < c.output.size()) {
+            ssize_t n = ::write(c.fd, c.output.data() + sent, c.output.size() - sent);
+            if (n > 0) {
+                sent += (size_t)n;
+            } else {
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) c.failed = true;
+                break;
+            }
+        }
+        c.output.erase(0, sent);
+    }
+
+    static void appendFloat(std::string& out, float value) {
+        char text[32];
+        auto result = std::to_chars(text, text + sizeof(text), value);
+        out.append(text, result.ptr);
+    }
+
+    // Parses the waiting lines of every client (up to maxBatch launches),
+    // simulates them as one batch and queues the replies
+    void serveBatch() {
+        ProjectileBatch batch;
+        std::vector<Request> requests;
+        size_t count = connections.size();
+        for (size_t k = 0; k < count && batch.size() < maxBatch; k++) {
+            Connection& c = *connections[(first + k) % count];
+            size_t start = 0, end;
+            while (batch.size() < maxBatch && !c.failed && c.output.size() < OUTPUT_LIMIT &&
+                   (end = c.input.find('\n', start)) != std::string::npos) {
+                ProjectileData data;
+                bool blank;
+                bool ok = parseLaunchSpec(c.input.substr(start, end - start), data, blank);
+                start = end + 1;
+                if (blank) continue;
+                requests.push_back(Request{&c, ok ? (long)batch.size() : -1});
+                if (ok) batch.add(data);
+            }
+            c.input.erase(0, start);
+            c.scanned = c.input.find('\n') == std::string::npos ? c.input.size() : 0;
+        }
+        if (count) first = (first + 1) % count;
+        if (requests.empty()) return;
+
+        BatchResults results;
+        {
+            PROFILE_SCOPE("server.batch");
+            runner.run(batch, results);
+        }
+        PROFILE_COUNT("server.requests", requests.size());
+        requestCount += requests.size();
+        batchCount++;
+
+        for (const Request& request : requests) {
+            std::string& out = request.connection->output;
+            if (request.launch < 0) {
+                out += "error: expected ";
+                out += LAUNCH_SPEC_FORMAT;
+            } else {
+                appendFloat(out, results.maxHeight[request.launch]);
+                out += ' ';
+                appendFloat(out, results.range[request.launch]);
+                out += ' ';
+                appendFloat(out, results.flightTime[request.launch]);
+            }
+            out += '\n';
+        }
+        for (auto& c : connections) {
+            if (!c->output.empty()) send(*c);
+        }
+    }
+
+    void closeFinished() {
+        size_t kept = 0;
+        for (size_t i = 0; i < connections.size(); i++) {
+            Connection& c = *connections[i];
+            bool done = c.failed || (c.eof && c.input.empty() && c.output.empty());
+            if (done) {
+                ::close(c.fd);
+            } else {
+                connections[kept++] = std::move(connections[i]);
+            }
+        }
+        connections.resize(kept);
+    }
+
+    Impl(unsigned threads, size_t maxBatch)
+        : listener(-1), runner(threads), maxBatch(std::max<size_t>(maxBatch, 1)), first(0),
+          stopping(false), requestCount(0), batchCount(0) {
+        wake[0] = wake[1] = -1;
+    }
+
+    ~Impl() {
+        for (auto& c : connections) ::close(c->fd);
+        if (listener >= 0) ::close(listener);
+        if (!unixPath.empty()) ::unlink(unixPath.c_str());
+        if (wake[0] >= 0) ::close(wake[0]);
+        if (wake[1] >= 0) ::close(wake[1]);
+    }
+
+    bool listen(const std::string& address, std::string& error) {
+        if (pipe(wake) != 0 || !setNonBlocking(wake[0]) || !setNonBlocking(wake[1])) {
+            error = "cannot create the wake-up pipe";
+            return false;
+        }
+
+        if (address.compare(0, 5, "unix:") == 0) {
+            sockaddr_un local;
+            std::memset(&local, 0, sizeof(local));
+            local.sun_family = AF_UNIX;
+            std::string path = address.substr(5);
+            if (path.empty() || path.size() >= sizeof(local.sun_path)) {
+                error = "invalid socket path '" + path + "'";
+                return false;
+            }
+            std::memcpy(local.sun_path, path.c_str(), path.size() + 1);
+            listener = socket(AF_UNIX, SOCK_STREAM, 0);
+            ::unlink(path.c_str());
+            if (listener < 0 || bind(listener, (sockaddr*)&local, sizeof(local)) != 0) {
+                error = "cannot bind '" + path + "': " + std::strerror(errno);
+                return false;
+            }
+            unixPath = path;
+        } else {
+            size_t colon = address.rfind(':');
+            std::string host = colon == std::string::npos ? "127.0.0.1" : address.substr(0, colon);
+            uint64_t port;
+            sockaddr_in inet;
+            std::memset(&inet, 0, sizeof(inet));
+            inet.sin_family = AF_INET;
+            if (!parseCount(address.substr(colon == std::string::npos ? 0 : colon + 1), port) || port > 65535 ||
+                inet_pton(AF_INET, host.c_str(), &inet.sin_addr) != 1) {
+                error = "invalid address '" + address + "' (expected PORT, HOST:PORT or unix:PATH)";
+                return false;
+            }
+            inet.sin_port = htons((uint16_t)port);
+            listener = socket(AF_INET, SOCK_STREAM, 0);
+            int reuse = 1;
+            if (listener >= 0) setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            if (listener < 0 || bind(listener, (sockaddr*)&inet, sizeof(inet)) != 0) {
+                error = "cannot bind '" + address + "': " + std::strerror(errno);
+                return false;
+            }
+        }
+        if (::listen(listener, 128) != 0 || !setNonBlocking(listener)) {
+            error = std::string("cannot listen: ") + std::strerror(errno);
+            return false;
+        }
+        return true;
+    }
+
+    int port() const {
+        sockaddr_in bound;
+        socklen_t length = sizeof(bound);
+        if (!unixPath.empty() || getsockname(listener, (sockaddr*)&bound, &length) != 0) return 0;
+        return ntohs(bound.sin_port);
+    }
+
+    void run() {
+        signal(SIGPIPE, SIG_IGN);
+        std::vector<pollfd> fds;
+        while (!stopping) {
+            bool pending = false;
+            fds.assign(1, pollfd{wake[0], POLLIN, 0});
+            fds.push_back(pollfd{listener, POLLIN, 0});
+            for (auto& c : connections) {
+                short events = (short)((readable(*c) ? POLLIN : 0) | (c->output.empty() ? 0 : POLLOUT));
+                fds.push_back(pollfd{c->fd, events, 0});
+                pending = pending || hasLine(*c);
+            }
+            if (poll(fds.data(), fds.size(), pending ? 0 : -1) < 0 && errno != EINTR) break;
+            if (stopping) break;
+
+            if (fds[1].revents & POLLIN) accept();
+            for (size_t i = 2; i < fds.size(); i++) {
+                Connection& c = *connections[i - 2];
+                if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) receive(c);
+                if (fds[i].revents & POLLOUT) send(c);
+                if (fds[i].revents & POLLNVAL) c.failed = true;
+            }
+            serveBatch();
+            closeFinished();
+        }
+    }
+
+    void stop() {
+        stopping = true;
+        if (wake[1] >= 0) {
+            char byte = 0;
+            ssize_t ignored = ::write(wake[1], &byte, 1);
+            (void)ignored;
+        }
+    }
+};
+
+
+SimulationServer::SimulationServer(unsigned threads, size_t maxBatch) : impl(new Impl(threads, maxBatch)) {}
+
+SimulationServer::~SimulationServer() {}
+
+bool SimulationServer::listen(const std::string& address, std::string& error) { return impl->listen(address, error); }
+
+int SimulationServer::port() const { return impl->port(); }
+
+void SimulationServer::run() { impl->run(); }
+
+void SimulationServer::stop() { impl->stop(); }
+
+uint64_t SimulationServer::requests() const { return impl->requestCount; }
+
+uint64_t SimulationServer::batches() const { return impl->batchCount; }
+
+#endif
@@ -0,0 +1,24 @@
+// Minimal check helpers shared by the ctest programs. Each test reports
+// every failed check and exits non-zero if there was one.
+#ifndef PROJECTILE_TEST_H
+#define PROJECTILE_TEST_H
+
+#include <iostream>
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << "\n";
+        failures++;
+    }
+}
+
+// Exit status for main(); prints a line naming the suite on success
+static int report(const char* suite) {
+    if (failures) return 1;
+    std::cout << "all " << suite << " checks passed\n";
+    return 0;
+}
+
+#endif // PROJECTILE_TEST_H